@@ -0,0 +1,194 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "arena.h"
+#include "rng.h"
+
+/* Events taken from epoll at once, and how often the matches are checked for
+ * players past their deadline when there are deadlines.
+ */
+#define MAX_EVENTS 256
+#define TICK_NS 10000000LL
+
+struct ArenaMatch;
+
+/* What an epoll event points at: one seat of a match, and the process whose
+ * pipe is watched for it.
+ */
+typedef struct{
+   struct ArenaMatch *match;
+   int seat;
+   pid_t pid;
+} Watch;
+
+typedef struct ArenaMatch{
+   Player players[2];
+   Score scores[2];
+   Game game;
+   Watch watch[2];
+   unsigned long long played, index, seed;
+   int done;
+} ArenaMatch;
+
+/* Every process player keeps two pipes open in the host, so the host may need
+ * far more files than it is allowed by default.
+ */
+static void raiseFileLimit(void) {
+   struct rlimit r;
+   if(getrlimit(RLIMIT_NOFILE, &r) == 0 && r.rlim_cur < r.rlim_max) {
+      r.rlim_cur = r.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &r);
+   }
+}
+
+static void control(int epfd, int op, int fd, unsigned events, Watch *w) {
+   struct epoll_event ev;
+   ev.events = events;
+   ev.data.ptr = w;
+   if(epoll_ctl(epfd, op, fd, &ev)) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/* Adds the pipe a process player answers through to epoll, unarmed. The pipe
+ * changes when the player is started again, and the old one left epoll when
+ * it was closed.
+ */
+static void watch(int epfd, ArenaMatch *m, int seat) {
+   Player *p = &m->players[seat];
+   if(p->plugin || p->pid == m->watch[seat].pid)
+      return;
+   if(fcntl(p->conn.rfd, F_SETFL, O_NONBLOCK)) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   m->watch[seat].pid = p->pid;
+   control(epfd, EPOLL_CTL_ADD, p->conn.rfd, EPOLLONESHOT, &m->watch[seat]);
+}
+
+static void startGame(Arena *a, int epfd, ArenaMatch *m) {
+   gameStart(&m->game, &m->players[0], &m->players[1], &m->scores[0], &m->scores[1],
+      NULL, a->simultaneous);
+   watch(epfd, m, 0);
+   watch(epfd, m, 1);
+}
+
+/* Plays a match on until it waits for answers that haven't arrived, and arms
+ * the pipes of the players it waits for. Returns 1 once the match is over.
+ */
+static int advance(Arena *a, int epfd, ArenaMatch *m) {
+   int seat;
+   while(gameStep(&m->game, 0)) {
+      if(a->results)
+         resultsGame(a->results, m->index, m->played + 1, m->seed, &m->game.wins,
+            &m->scores[0], &m->scores[1]);
+      endGame(&m->scores[0]);
+      endGame(&m->scores[1]);
+      if(++m->played == a->games) {
+         for(seat = 0; seat < 2; seat++) {
+            endMatch(&m->players[seat]);
+            addScore(&a->scores[seat], &m->scores[seat]);
+         }
+         if(a->results)
+            resultsMatch(a->results, m->index, m->played, m->seed, &m->scores[0],
+               &m->scores[1]);
+         m->done = 1;
+         return 1;
+      }
+      startGame(a, epfd, m);
+   }
+   for(seat = 0; seat < 2; seat++) {
+      if(m->game.waiting >> seat & 1)
+         control(epfd, EPOLL_CTL_MOD, m->players[seat].conn.rfd, EPOLLIN | EPOLLONESHOT,
+            &m->watch[seat]);
+   }
+   return 0;
+}
+
+static void setupMatch(Arena *a, ArenaMatch *m, unsigned long long index,
+   unsigned long long seed) {
+   MatchStart start;
+   int seat = 0;
+   for(; seat < 2; seat++) {
+      start = seatStart(seed, seat, a->size);
+      nameOpponent(&start, a->args[1 - seat]);
+      setupPlayer(&m->players[seat], a->args[seat], 0, &start);
+      setupDeadlines(&m->players[seat], a->moveNs, a->matchNs);
+      m->players[seat].timing = a->timing[seat];
+      m->players[seat].stats = a->stats[seat];
+      m->scores[seat] = setupScore();
+      m->watch[seat].match = m;
+      m->watch[seat].seat = seat;
+      m->watch[seat].pid = -1;
+   }
+   m->played = m->done = 0;
+   m->index = index;
+   m->seed = seed;
+}
+
+/* Deadlines pass without the pipe becoming readable, so every match waiting
+ * on a player is checked once a tick.
+ */
+static int checkDeadlines(Arena *a, int epfd, ArenaMatch *matches) {
+   long long now = monotonicNs();
+   Player *p;
+   int i = 0, ended = 0, seat;
+   for(; i < a->matches; i++) {
+      for(seat = 0; seat < 2 && !matches[i].done; seat++) {
+         p = &matches[i].players[seat];
+         if(matches[i].game.waiting >> seat & 1 && p->conn.deadline && now >= p->conn.deadline)
+            ended += advance(a, epfd, &matches[i]);
+      }
+   }
+   return ended;
+}
+
+/* All the players are started before any match asks for a board, so no
+ * player's clock runs while the host is busy starting the others.
+ */
+void arenaRun(Arena *a) {
+   ArenaMatch *matches = malloc(a->matches * sizeof(ArenaMatch));
+   struct epoll_event events[MAX_EVENTS];
+   unsigned long long seed = a->seed;
+   long long tick = a->moveNs || a->matchNs ? monotonicNs() + TICK_NS : 0;
+   int epfd, active = a->matches, i = 0, n;
+   Watch *w;
+   if(matches == NULL || (epfd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   raiseFileLimit();
+   a->scores[0] = setupScore();
+   a->scores[1] = setupScore();
+   for(; i < a->matches; i++)
+      setupMatch(a, &matches[i], i, rngNext(&seed));
+   for(i = 0; i < a->matches; i++) {
+      startGame(a, epfd, &matches[i]);
+      active -= advance(a, epfd, &matches[i]);
+   }
+   while(active > 0) {
+      n = epoll_wait(epfd, events, MAX_EVENTS, tick ? TICK_NS / 1000000 : -1);
+      if(n == -1 && errno != EINTR) {
+         perror(NULL);
+         exit(EXIT_FAILURE);
+      }
+      for(i = 0; i < n; i++) {
+         w = events[i].data.ptr;
+         if(!w->match->done && w->match->game.waiting >> w->seat & 1)
+            active -= advance(a, epfd, w->match);
+      }
+      if(tick && monotonicNs() >= tick) {
+         active -= checkDeadlines(a, epfd, matches);
+         tick = monotonicNs() + TICK_NS;
+      }
+   }
+   close(epfd);
+   free(matches);
+}
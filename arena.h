@@ -0,0 +1,32 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "match.h"
+#include "results.h"
+
+/* Many matches between the same two players, all played at once by one
+ * thread. Every match has its own pair of player processes, and the thread
+ * sleeps in epoll until one of them answers, so a match costs its Game and
+ * Players rather than a host process of its own. Process players talk through
+ * pipes, and plugins simply answer when asked.
+ *
+ * Match i starts its players with seatStart of the i-th seed drawn from seed.
+ * The scores, timings and stats of a seat add up over all the matches. With
+ * simultaneous set both players of a match are asked for their shots at once.
+ * The games are played on a size x size board. With results set every game
+ * and match is written to it as it ends.
+ */
+typedef struct{
+   char *args[2];
+   int matches, simultaneous, size;
+   unsigned long long games, seed;
+   long long moveNs, matchNs;       /* deadlines given to every player */
+   Timing *timing[2];               /* NULL to not time the answers */
+   Results *results;                /* NULL to not write the results */
+   Stats *stats[2];                 /* NULL to not count the shots and boards */
+   Score scores[2];
+} Arena;
+
+void arenaRun(Arena *a);
+
+#endif
@@ -0,0 +1,325 @@
+#include "../match.c"
+#include "../arena.h"
+#include "../histogram.h"
+#include "../placements.h"
+#include "../sampler.h"
+#include "../players/density.h"
+
+/* Benchmarks of the host's hot paths: resolving shots, reading boards, the
+ * round trip of a message to a player and whole games, plus the cost of the
+ * smart player's density engine and of drawing random fleets. match.c is
+ * included so its static functions can be timed on their own.
+ * Usage: hostbench [-b baseline] [-o file] [player] [plugin]
+ *
+ * player and plugin default to the basic player in build/players, which
+ * answers at a fixed cost. Every result is compared with the same line of
+ * baseline, and -o writes the results in the format of a baseline.
+ */
+
+#define BOARDS 1000
+#define RESOLVE_ROUNDS 200
+#define ROUND_TRIPS 50000
+#define PROCESS_GAMES 500
+#define PLUGIN_GAMES 20000
+#define DENSITY_GAMES 2000
+#define SAMPLER_FLEETS 1000000
+#define ARENA_MATCHES 64
+#define ARENA_GAMES 20
+#define MAX_METRICS 64
+#define MAX_METRIC_NAME 40
+
+#define PLAYER "build/players/basicPlayer"
+#define PLUGIN "build/players/basicPlayer.so"
+
+typedef struct{
+   int count;
+   char names[MAX_METRICS][MAX_METRIC_NAME];
+   double values[MAX_METRICS];
+} Metrics;
+
+static Metrics baseline, results;
+static Fleet fleets[BOARDS];
+static Shot orders[BOARDS][SIZE * SIZE];
+static BoardState states[BOARDS];
+static volatile unsigned long long keep;    /* results the compiler must not drop */
+
+static void printFileUsage() {
+   fprintf(stderr, "Usage: hostbench [-b baseline] [-o file] [player] [plugin]\n");
+   exit(EXIT_FAILURE);
+}
+
+static void readBaseline(const char *path) {
+   FILE *file = fopen(path, "r");
+   if(file == NULL) {
+      fprintf(stderr, "no baseline in %s\n", path);
+      return;
+   }
+   while(baseline.count < MAX_METRICS && fscanf(file, "%39s %lf",
+      baseline.names[baseline.count], &baseline.values[baseline.count]) == 2)
+      baseline.count++;
+   fclose(file);
+}
+
+static void writeResults(const char *path) {
+   FILE *file = fopen(path, "w");
+   int i = 0;
+   if(file == NULL) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+   for(; i < results.count; i++)
+      fprintf(file, "%s %.1f\n", results.names[i], results.values[i]);
+   fclose(file);
+}
+
+/* Print a result next to its baseline, if there is one.
+ */
+static void report(const char *name, double value) {
+   int i = 0;
+   printf("%-28s %14.1f", name, value);
+   for(; i < baseline.count; i++) {
+      if(strcmp(baseline.names[i], name) == 0 && baseline.values[i] > 0) {
+         printf("   baseline %14.1f  %+6.1f%%", baseline.values[i],
+            100.0 * (value - baseline.values[i]) / baseline.values[i]);
+         break;
+      }
+   }
+   printf("\n");
+   fflush(stdout);
+   if(results.count < MAX_METRICS) {
+      snprintf(results.names[results.count], MAX_METRIC_NAME, "%s", name);
+      results.values[results.count++] = value;
+   }
+}
+
+static void reportLatency(const char *name, const Histogram *h) {
+   char line[MAX_METRIC_NAME];
+   snprintf(line, sizeof(line), "%s_p50_ns", name);
+   report(line, histPercentile(h, 50.0));
+   snprintf(line, sizeof(line), "%s_p99_ns", name);
+   report(line, histPercentile(h, 99.0));
+   snprintf(line, sizeof(line), "%s_p999_ns", name);
+   report(line, histPercentile(h, 99.9));
+}
+
+/* Random legal boards, and for each one the order its cells are shot in.
+ */
+static void setupBoards(void) {
+   FleetSampler *sampler = samplerCreate();
+   unsigned long long rng = 1;
+   int b = 0, i, j;
+   samplerStart(sampler, rng, SIZE);
+   for(; b < BOARDS; b++) {
+      samplerDraw(sampler, &fleets[b]);
+      for(i = 0; i < SIZE * SIZE; i++) {
+         j = rngBelow(&rng, i + 1);
+         orders[b][i] = orders[b][j];
+         orders[b][j].row = i / SIZE;
+         orders[b][j].col = i % SIZE;
+      }
+   }
+   samplerFree(sampler);
+}
+
+/* Time drawing uniform random fleets, on the standard board and the largest.
+ */
+static void benchSampler(void) {
+   FleetSampler *sampler = samplerCreate();
+   Fleet fleet;
+   unsigned long long sum = 0;
+   long long start;
+   int size = SIZE, i;
+   char line[MAX_METRIC_NAME];
+   for(; size <= MAX_SIZE; size = size == SIZE ? MAX_SIZE : MAX_SIZE + 1) {
+      samplerStart(sampler, 1, size);
+      start = monotonicNs();
+      for(i = 0; i < SAMPLER_FLEETS; i++) {
+         samplerDraw(sampler, &fleet);
+         sum += fleet.ships[i % NUMBER_OF_SHIPS].row;
+      }
+      snprintf(line, sizeof(line), "fleet%d_ns", size);
+      report(line, (double)(monotonicNs() - start) / SAMPLER_FLEETS);
+   }
+   samplerFree(sampler);
+   keep = sum;
+}
+
+static void benchResolve(void) {
+   long long start;
+   int round = 0, b, i, sum = 0;
+   for(b = 0; b < BOARDS; b++)
+      setupBoard(&states[b], &fleets[b], SIZE);
+   start = monotonicNs();
+   for(; round < RESOLVE_ROUNDS; round++) {
+      for(b = 0; b < BOARDS; b++) {
+         memset(states[b].hits, 0, states[b].words * sizeof(states[b].hits[0]));
+         memcpy(states[b].left, fleetLength, NUMBER_OF_SHIPS);
+         for(i = 0; i < SIZE * SIZE; i++)
+            sum += resolveShot(&states[b], orders[b][i]);
+      }
+   }
+   report("resolveShot_ns", (double)(monotonicNs() - start) /
+      ((double)RESOLVE_ROUNDS * BOARDS * SIZE * SIZE));
+   keep = sum;
+}
+
+static void benchSetupBoard(void) {
+   BoardState state;
+   long long start = monotonicNs();
+   int round = 0, b;
+   unsigned long long sum = 0;
+   initBoard(&state);
+   for(; round < RESOLVE_ROUNDS; round++) {
+      for(b = 0; b < BOARDS; b++) {
+         setupBoard(&state, &fleets[b], SIZE);
+         sum += state.shipAt[b % (SIZE * SIZE)];
+      }
+   }
+   report("setupBoard_ns", (double)(monotonicNs() - start) /
+      ((double)RESOLVE_ROUNDS * BOARDS));
+   keep = sum;
+}
+
+/* Time the round trips of NEW_GAME and SHOT_REQUEST to a process player.
+ */
+static void benchRoundTrips(char *player, int shm, const char *name) {
+   Player p;
+   MatchStart start = seatStart(1, 0, SIZE);
+   Histogram boardTimes, shotTimes;
+   BoardState board;
+   char line[MAX_METRIC_NAME];
+   Shot shot;
+   long long t, begin;
+   int i = 0;
+   histInit(&boardTimes);
+   histInit(&shotTimes);
+   initBoard(&board);
+   setupPlayer(&p, player, shm, &start);
+   takeBoard(&p, &board, SIZE, ask(&p, NEW_GAME));
+   for(i = 0; i < ROUND_TRIPS / 100; i++) {
+      t = monotonicNs();
+      takeBoard(&p, &board, SIZE, ask(&p, NEW_GAME));
+      histAdd(&boardTimes, monotonicNs() - t);
+   }
+   begin = monotonicNs();
+   for(i = 0; i < ROUND_TRIPS; i++) {
+      t = monotonicNs();
+      takeShot(&p, &shot, ask(&p, SHOT_REQUEST));
+      histAdd(&shotTimes, monotonicNs() - t);
+   }
+   t = monotonicNs() - begin;
+   endMatch(&p);
+   snprintf(line, sizeof(line), "%s_board", name);
+   reportLatency(line, &boardTimes);
+   snprintf(line, sizeof(line), "%s_shot", name);
+   reportLatency(line, &shotTimes);
+   snprintf(line, sizeof(line), "%s_msgs/s", name);
+   report(line, 2.0 * ROUND_TRIPS / (t / 1e9));
+}
+
+static void benchGames(char *a, char *b, int shm, int simultaneous, int games,
+   const char *name) {
+   Player pA, pB;
+   Score sA = setupScore(), sB = setupScore();
+   MatchStart startA = seatStart(1, 0, SIZE), startB = seatStart(1, 1, SIZE);
+   char line[MAX_METRIC_NAME];
+   long long t;
+   int wins[2], i = 0;
+   setupPlayer(&pA, a, shm, &startA);
+   setupPlayer(&pB, b, shm, &startB);
+   t = monotonicNs();
+   for(; i < games; i++) {
+      playGame(&pA, &pB, &sA, &sB, &wins, NULL, simultaneous);
+      endGame(&sA);
+      endGame(&sB);
+   }
+   t = monotonicNs() - t;
+   endMatch(&pA);
+   endMatch(&pB);
+   snprintf(line, sizeof(line), "%s_games/s", name);
+   report(line, games / (t / 1e9));
+   snprintf(line, sizeof(line), "%s_shots/s", name);
+   report(line, (sA.totalHits + sA.totalMisses + sB.totalHits + sB.totalMisses) / (t / 1e9));
+}
+
+/* Games played by one thread keeping many matches going at once.
+ */
+static void benchArena(char *player) {
+   Arena a;
+   long long t;
+   a.args[0] = a.args[1] = player;
+   a.matches = ARENA_MATCHES;
+   a.games = ARENA_GAMES;
+   a.seed = 1;
+   a.simultaneous = 0;
+   a.size = SIZE;
+   a.moveNs = a.matchNs = 0;
+   a.timing[0] = a.timing[1] = NULL;
+   a.results = NULL;
+   a.stats[0] = a.stats[1] = NULL;
+   t = monotonicNs();
+   arenaRun(&a);
+   t = monotonicNs() - t;
+   report("arena_games/s", (double)ARENA_MATCHES * ARENA_GAMES / (t / 1e9));
+}
+
+/* Cost of the density engine choosing and recording one shot, over whole
+ * games against the random boards.
+ */
+static void benchDensity(void) {
+   Density *d = densityCreate();
+   BoardState state;
+   Shot shot;
+   long long t = monotonicNs();
+   unsigned long long shots = 0;
+   int game = 0, result, sinks;
+   initBoard(&state);
+   for(; game < DENSITY_GAMES; game++) {
+      setupBoard(&state, &fleets[game % BOARDS], SIZE);
+      densityNewGame(d);
+      for(sinks = 0; sinks < NUMBER_OF_SHIPS && densityChoose(d, &shot); shots++) {
+         result = resolveShot(&state, shot);
+         sinks += result == SINK;
+         densityRecord(d, shot, result);
+      }
+   }
+   t = monotonicNs() - t;
+   report("density_shot_ns", (double)t / shots);
+   report("density_shots/game", (double)shots / DENSITY_GAMES);
+   densityFree(d);
+}
+
+int main(int argc, char **argv) {
+   char *player = PLAYER, *plugin = PLUGIN;
+   int c;
+   const char *out = NULL;
+   while((c = getopt(argc, argv, "b:o:")) != -1) {
+      if(c == 'b')
+         readBaseline(optarg);
+      else if(c == 'o')
+         out = optarg;
+      else
+         printFileUsage();
+   }
+   if(argc - optind > 2)
+      printFileUsage();
+   if(argc - optind > 0)
+      player = argv[optind];
+   if(argc - optind > 1)
+      plugin = argv[optind + 1];
+   setupBoards();
+   benchResolve();
+   benchSetupBoard();
+   benchSampler();
+   benchDensity();
+   benchRoundTrips(player, 0, "pipe");
+   benchRoundTrips(player, 1, "shm");
+   benchGames(player, player, 0, 0, PROCESS_GAMES, "pipe");
+   benchGames(player, player, 1, 0, PROCESS_GAMES, "shm");
+   benchGames(player, player, 0, 1, PROCESS_GAMES, "simultaneous");
+   benchGames(plugin, plugin, 0, 0, PLUGIN_GAMES, "plugin");
+   benchArena(player);
+   if(out != NULL)
+      writeResults(out);
+   return EXIT_SUCCESS;
+}
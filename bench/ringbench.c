@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "../ring.h"
+
+/* Round-trip latency of one Shot-sized message between two processes, through
+ * a pair of pipes and through a pair of shared memory rings.
+ * Usage: ringbench [round trips]
+ */
+
+#define ROUND_TRIPS 100000
+#define MESSAGE 4
+
+static long long now(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compareTimes(const void *a, const void *b) {
+   long long x = *(const long long *)a, y = *(const long long *)b;
+   return (x > y) - (x < y);
+}
+
+static void report(const char *name, long long *t, int n) {
+   long long sum = 0;
+   int i = 0;
+   for(; i < n; i++)
+      sum += t[i];
+   qsort(t, n, sizeof(long long), compareTimes);
+   printf("%8s: %d round trips, mean %lld ns, p50 %lld ns, p99 %lld ns, ",
+      name, n, sum / n, t[n / 2], t[(long long)n * 99 / 100]);
+   printf("p999 %lld ns\n", t[(long long)n * 999 / 1000]);
+}
+
+static void fail(void) {
+   fprintf(stderr, "failure in %s at line %d\n", __FILE__, __LINE__);
+   exit(EXIT_FAILURE);
+}
+
+static void benchPipes(long long *t, int n) {
+   int toChild[2], fromChild[2], i = 0;
+   char msg[MESSAGE] = {0};
+   pid_t pid;
+   if(pipe(toChild) || pipe(fromChild))
+      fail();
+   if((pid = fork()) == 0) {
+      for(; i < n; i++) {
+         if(read(toChild[0], msg, MESSAGE) != MESSAGE ||
+            write(fromChild[1], msg, MESSAGE) != MESSAGE)
+            fail();
+      }
+      _exit(EXIT_SUCCESS);
+   }
+   for(; i < n; i++) {
+      t[i] = now();
+      if(write(toChild[1], msg, MESSAGE) != MESSAGE ||
+         read(fromChild[0], msg, MESSAGE) != MESSAGE)
+         fail();
+      t[i] = now() - t[i];
+   }
+   waitpid(pid, NULL, 0);
+}
+
+static void benchRings(long long *t, int n) {
+   int fd, i = 0;
+   char msg[MESSAGE] = {0};
+   RingPair *rings = ringCreate(&fd);
+   pid_t pid, host = getpid();
+   if((pid = fork()) == 0) {
+      for(; i < n; i++) {
+         if(ringRead(&rings->toPlayer, msg, MESSAGE, host, 0) != MESSAGE ||
+            ringWrite(&rings->fromPlayer, msg, MESSAGE, host, 0))
+            fail();
+      }
+      _exit(EXIT_SUCCESS);
+   }
+   for(; i < n; i++) {
+      t[i] = now();
+      if(ringWrite(&rings->toPlayer, msg, MESSAGE, pid, 0) ||
+         ringRead(&rings->fromPlayer, msg, MESSAGE, pid, 0) != MESSAGE)
+         fail();
+      t[i] = now() - t[i];
+   }
+   waitpid(pid, NULL, 0);
+   ringRelease(rings);
+}
+
+int main(int argc, char **argv) {
+   int n = argc > 1 ? atoi(argv[1]) : ROUND_TRIPS;
+   long long *t = malloc(n * sizeof(long long));
+   if(n <= 0 || t == NULL)
+      fail();
+   benchPipes(t, n);
+   report("pipes", t, n);
+   benchRings(t, n);
+   report("shm", t, n);
+   free(t);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <string.h>
+#include "battleship.h"
+
+/* Cells on the largest board, and the 64-bit words holding a set of them.
+ */
+#define MAX_CELLS (MAX_SIZE*MAX_SIZE)
+#define BOARD_WORDS (MAX_CELLS / 64)
+
+/* A set of board cells, one bit per cell numbered row by row, so cell
+ * row*size + col is bit cell % 64 of word cell / 64. A board of any size up to
+ * MAX_SIZE fits, and only the first boardWords(size) words are used.
+ */
+typedef struct{
+   unsigned long long words[BOARD_WORDS];
+} Bitboard;
+
+static inline int boardWords(int size) {
+   return (size*size + 63) / 64;
+}
+
+static inline void clearCells(Bitboard *b, int words) {
+   memset(b->words, 0, words * sizeof(b->words[0]));
+}
+
+static inline void addCell(Bitboard *b, int cell) {
+   b->words[cell >> 6] |= 1ULL << (cell & 63);
+}
+
+static inline void removeCell(Bitboard *b, int cell) {
+   b->words[cell >> 6] &= ~(1ULL << (cell & 63));
+}
+
+static inline int hasCell(const Bitboard *b, int cell) {
+   return b->words[cell >> 6] >> (cell & 63) & 1;
+}
+
+/* The lowest numbered cell of a set, or -1 when it is empty.
+ */
+static inline int firstCell(const Bitboard *b, int words) {
+   int i = 0;
+   for(; i < words; i++) {
+      if(b->words[i])
+         return i * 64 + __builtin_ctzll(b->words[i]);
+   }
+   return -1;
+}
+
+static inline int bitCount(const Bitboard *b, int words) {
+   int i = 0, n = 0;
+   for(; i < words; i++)
+      n += __builtin_popcountll(b->words[i]);
+   return n;
+}
+
+#endif
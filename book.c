@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "book.h"
+
+static void *allocate(size_t size) {
+   void *p = malloc(size);
+   if(p == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   return p;
+}
+
+void bookWrite(const char *path, int size, const Fleet *fleets, unsigned int count) {
+   FILE *out = fopen(path, "wb");
+   BookHeader h;
+   if(out == NULL) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, BOOK_MAGIC, sizeof(h.magic));
+   h.size = size;
+   h.count = count;
+   if(fwrite(&h, sizeof(h), 1, out) != 1 || fwrite(fleets, sizeof(Fleet), count, out) != count
+      || fclose(out)) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+}
+
+void openingsWrite(const char *path, int size, int depth, const unsigned short *cells) {
+   FILE *out = fopen(path, "wb");
+   OpeningsHeader h;
+   memcpy(h.magic, OPENINGS_MAGIC, sizeof(h.magic));
+   h.size = size;
+   h.depth = depth;
+   h.count = openingNodes(depth);
+   if(out == NULL || fwrite(&h, sizeof(h), 1, out) != 1 ||
+      fwrite(cells, sizeof(cells[0]), h.count, out) != h.count || fclose(out)) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/* Maps a book of the given kind into memory along with its length, and
+ * checks it is at least as long as its header and starts with magic. A
+ * player would rather play without a book than forfeit, so a book that can't
+ * be used is reported and NULL returned.
+ */
+static const void *mapBook(const char *path, const char *magic, const char *kind,
+   size_t header, size_t *length) {
+   struct stat st;
+   const void *data;
+   int fd = open(path, O_RDONLY);
+   if(fd == -1 || fstat(fd, &st) == -1) {
+      perror(path);
+      if(fd != -1)
+         close(fd);
+      return NULL;
+   }
+   *length = st.st_size;
+   data = *length < header ? MAP_FAILED : mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if(data != MAP_FAILED && memcmp(data, magic, 4) == 0)
+      return data;
+   if(data != MAP_FAILED)
+      munmap((void *)data, *length);
+   fprintf(stderr, "%s is not %s\n", path, kind);
+   return NULL;
+}
+
+Book *bookOpen(const char *path) {
+   size_t length;
+   const void *data = mapBook(path, BOOK_MAGIC, "a placement book", sizeof(BookHeader), &length);
+   Book *b;
+   if(data == NULL)
+      return NULL;
+   b = allocate(sizeof(Book));
+   b->data = data;
+   b->length = length;
+   memcpy(&b->header, data, sizeof(BookHeader));
+   if(b->header.size < SIZE || b->header.size > MAX_SIZE || b->header.count == 0
+      || length != sizeof(BookHeader) + b->header.count * sizeof(Fleet)) {
+      fprintf(stderr, "%s is not a placement book\n", path);
+      bookClose(b);
+      return NULL;
+   }
+   b->fleets = (const Fleet *)((const char *)data + sizeof(BookHeader));
+   return b;
+}
+
+void bookClose(Book *b) {
+   munmap((void *)b->data, b->length);
+   free(b);
+}
+
+Openings *openingsOpen(const char *path) {
+   size_t length;
+   const void *data = mapBook(path, OPENINGS_MAGIC, "an opening book",
+      sizeof(OpeningsHeader), &length);
+   Openings *o;
+   if(data == NULL)
+      return NULL;
+   o = allocate(sizeof(Openings));
+   o->data = data;
+   o->length = length;
+   memcpy(&o->header, data, sizeof(OpeningsHeader));
+   if(o->header.size < SIZE || o->header.size > MAX_SIZE || o->header.depth < 1 ||
+      o->header.depth > MAX_DEPTH || o->header.count != openingNodes(o->header.depth) ||
+      length != sizeof(OpeningsHeader) + o->header.count * sizeof(o->cells[0])) {
+      fprintf(stderr, "%s is not an opening book\n", path);
+      openingsClose(o);
+      return NULL;
+   }
+   o->cells = (const unsigned short *)((const char *)data + sizeof(OpeningsHeader));
+   return o;
+}
+
+void openingsClose(Openings *o) {
+   munmap((void *)o->data, o->length);
+   free(o);
+}
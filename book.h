@@ -0,0 +1,69 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stddef.h>
+#include "battleship.h"
+#include "protocol.h"
+
+/* The books a player maps into memory and reads as they are, so opening one
+ * costs no more than the mapping.
+ *
+ * A placement book is a BookHeader followed by count Fleets, as placebook
+ * writes them for one size of board.
+ */
+#define BOOK_MAGIC "BSB1"
+
+typedef struct{
+   char magic[4];
+   unsigned int size;            /* of the board the fleets are placed on */
+   unsigned int count;
+   unsigned int reserved;
+} BookHeader;
+
+typedef struct{
+   BookHeader header;
+   const Fleet *fleets;
+   const void *data;
+   size_t length;
+} Book;
+
+/* An opening book is an OpeningsHeader followed by count cells, the shots of
+ * an opening as a complete trie of the results seen so far: the root, node
+ * 0, is the first shot, and the shot after node i gave result r (MISS, HIT or
+ * SINK) is node 3*i + r. count is (3^depth - 1) / 2 for an opening of depth
+ * shots. A cell is row*size + col, or NO_OPENING where no game gets to that
+ * node and the book has nothing to say.
+ */
+#define OPENINGS_MAGIC "BSO1"
+#define MAX_DEPTH 16
+#define NO_OPENING 0xFFFF
+
+typedef struct{
+   char magic[4];
+   unsigned int size;
+   unsigned int depth;
+   unsigned int count;
+} OpeningsHeader;
+
+typedef struct{
+   OpeningsHeader header;
+   const unsigned short *cells;
+   const void *data;
+   size_t length;
+} Openings;
+
+static inline unsigned int openingNodes(int depth) {
+   unsigned int n = 1;
+   while(depth-- > 0)
+      n *= 3;
+   return (n - 1) / 2;
+}
+
+void bookWrite(const char *path, int size, const Fleet *fleets, unsigned int count);
+Book *bookOpen(const char *path);
+void bookClose(Book *b);
+void openingsWrite(const char *path, int size, int depth, const unsigned short *cells);
+Openings *openingsOpen(const char *path);
+void openingsClose(Openings *o);
+
+#endif
@@ -0,0 +1,382 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gamelog.h"
+#include "placements.h"
+
+/* Largest encoded game: length, outcome, five counts, two raw boards and
+ * every shot off the board.
+ */
+#define VARINT_MAX 10
+#define RECORD_MAX (VARINT_MAX + 1 + 5 * VARINT_MAX + 2 * (1 + MAX_CELLS) + \
+   2 * MAX_CELLS * VARINT_MAX)
+
+#define PLACED_BOARD 0
+#define RAW_BOARD 1
+
+static int putVarint(unsigned char *out, unsigned long long v) {
+   int n = 0;
+   for(; v >= 0x80; v >>= 7)
+      out[n++] = (unsigned char)v | 0x80;
+   out[n++] = (unsigned char)v;
+   return n;
+}
+
+/* Read a varint from at without going past end. Returns 0 if it doesn't
+ * fit.
+ */
+static int getVarint(const unsigned char **at, const unsigned char *end,
+   unsigned long long *v) {
+   const unsigned char *p = *at;
+   int shift = 0;
+   *v = 0;
+   for(; p < end && shift < 64; shift += 7) {
+      *v |= (unsigned long long)(*p & 0x7f) << shift;
+      if(!(*p++ & 0x80)) {
+         *at = p;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+static void corrupt(void) {
+   fprintf(stderr, "corrupt game log\n");
+   exit(EXIT_FAILURE);
+}
+
+static unsigned long long nextVarint(const unsigned char **at, const unsigned char *end) {
+   unsigned long long v;
+   if(!getVarint(at, end, &v))
+      corrupt();
+   return v;
+}
+
+/* Whether a ship lies on the cells from cell on in steps of step.
+ */
+static int lies(const Bitboard *ship, int cell, int step, int length) {
+   int i = 0;
+   for(; i < length; i++) {
+      if(!hasCell(ship, cell + i * step))
+         return 0;
+   }
+   return 1;
+}
+
+/* Find the number of each ship's placement. Returns 0 unless every ship lies
+ * on exactly one of its placements.
+ */
+static int findPlacements(const Bitboard *ships, int size, int *index) {
+   int words = boardWords(size), ship = 0, cell, length;
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      length = fleetLength[ship];
+      cell = firstCell(&ships[ship], words);
+      if(cell == -1 || bitCount(&ships[ship], words) != length)
+         return 0;
+      if(cell % size + length <= size && lies(&ships[ship], cell, 1, length))
+         index[ship] = placementNumber(size, length, cell, 0);
+      else if(cell / size + length <= size && lies(&ships[ship], cell, size, length))
+         index[ship] = placementNumber(size, length, cell, 1);
+      else
+         return 0;
+   }
+   return 1;
+}
+
+/* Write a board as the placements of its ships when it can be, and as its
+ * cells otherwise.
+ */
+static int encodeBoard(unsigned char *out, const Bitboard *ships, int size) {
+   int index[NUMBER_OF_SHIPS], ship = 0, at = 1, cell;
+   if(!findPlacements(ships, size, index)) {
+      out[0] = RAW_BOARD;
+      memset(out + 1, OPEN_WATER, size * size);
+      for(; ship < NUMBER_OF_SHIPS; ship++) {
+         for(cell = 0; cell < size * size; cell++) {
+            if(hasCell(&ships[ship], cell))
+               out[1 + cell] = (ship + 1) * AIRCRAFT_CARRIER;
+         }
+      }
+      return 1 + size * size;
+   }
+   out[0] = PLACED_BOARD;
+   for(; ship < NUMBER_OF_SHIPS; ship++)
+      at += putVarint(out + at, index[ship]);
+   return at;
+}
+
+static void decodeBoard(const unsigned char **at, const unsigned char *end,
+   Bitboard *ships, int size) {
+   unsigned long long n;
+   int ship = 0, i, cell, down;
+   memset(ships, 0, NUMBER_OF_SHIPS * sizeof(Bitboard));
+   if(*at >= end)
+      corrupt();
+   if(*(*at)++ == RAW_BOARD) {
+      if(end - *at < size * size)
+         corrupt();
+      for(cell = 0; cell < size * size; cell++) {
+         if((ship = cellShip((char)(*at)[cell])) != -1)
+            addCell(&ships[ship], cell);
+      }
+      *at += size * size;
+      return;
+   }
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      n = nextVarint(at, end);
+      if(n > MAX_CELLS * 2 ||
+         (cell = placementStart(size, fleetLength[ship], (int)n, &down)) == -1)
+         corrupt();
+      for(i = 0; i < fleetLength[ship]; i++)
+         addCell(&ships[ship], cell + i * (down ? size : 1));
+   }
+}
+
+static int encodeGame(unsigned char *out, const GameRecord *game) {
+   int at = 0, i = 0, seat;
+   out[at++] = (game->wins[0] != 0) | (game->wins[1] != 0) << 1 |
+      (game->forfeits[0] != 0) << 2 | (game->forfeits[1] != 0) << 3;
+   at += putVarint(out + at, game->shotCount);
+   for(seat = 0; seat < 2; seat++) {
+      at += putVarint(out + at, game->hits[seat]);
+      at += putVarint(out + at, game->sinks[seat]);
+   }
+   at += encodeBoard(out + at, game->ships[0], game->size);
+   at += encodeBoard(out + at, game->ships[1], game->size);
+   for(; i < game->shotCount; i++) {
+      if(game->shots[i].row < game->size && game->shots[i].col < game->size)
+         at += putVarint(out + at, game->shots[i].row * game->size + game->shots[i].col);
+      else
+         at += putVarint(out + at, game->size * game->size +
+            ((unsigned long long)game->shots[i].row << 16 | game->shots[i].col));
+   }
+   return at;
+}
+
+static void writeAll(int fd, const unsigned char *data, size_t length) {
+   ssize_t n;
+   while(length > 0) {
+      if((n = write(fd, data, length)) <= 0) {
+         perror(NULL);
+         exit(EXIT_FAILURE);
+      }
+      data += n;
+      length -= n;
+   }
+}
+
+static LogBuffer *newBuffer(void) {
+   LogBuffer *b = malloc(sizeof(LogBuffer));
+   if(b == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   b->used = 0;
+   return b;
+}
+
+/* Writes out the full buffers in order and gives them back as spares.
+ */
+static void *writeLog(void *arg) {
+   GameLog *log = arg;
+   LogBuffer *b;
+   pthread_mutex_lock(&log->lock);
+   while(1) {
+      while(log->full == NULL && !log->closing)
+         pthread_cond_wait(&log->ready, &log->lock);
+      if((b = log->full) == NULL)
+         break;
+      log->full = b->next;
+      pthread_mutex_unlock(&log->lock);
+      writeAll(log->fd, b->data, b->used);
+      b->used = 0;
+      pthread_mutex_lock(&log->lock);
+      b->next = log->spare;
+      log->spare = b;
+   }
+   pthread_mutex_unlock(&log->lock);
+   return NULL;
+}
+
+/* Queue the current buffer for the writer and take a spare, or a new buffer
+ * if there is none.
+ */
+static void handOff(GameLog *log) {
+   LogBuffer *b = log->current;
+   b->next = NULL;
+   pthread_mutex_lock(&log->lock);
+   if(log->full == NULL)
+      log->full = b;
+   else
+      log->last->next = b;
+   log->last = b;
+   if((log->current = log->spare) != NULL)
+      log->spare = log->spare->next;
+   pthread_cond_signal(&log->ready);
+   pthread_mutex_unlock(&log->lock);
+   if(log->current == NULL)
+      log->current = newBuffer();
+}
+
+GameLog *logCreate(const char *path, const LogHeader *header) {
+   GameLog *log = malloc(sizeof(GameLog));
+   if(log == NULL || (log->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+   writeAll(log->fd, (const unsigned char *)header, sizeof(LogHeader));
+   pthread_mutex_init(&log->lock, NULL);
+   pthread_cond_init(&log->ready, NULL);
+   log->current = newBuffer();
+   log->full = log->last = log->spare = NULL;
+   log->closing = 0;
+   if(pthread_create(&log->thread, NULL, writeLog, log)) {
+      fprintf(stderr, "thread failure in %s at line %d\n", __FILE__, __LINE__);
+      exit(EXIT_FAILURE);
+   }
+   return log;
+}
+
+void logGame(GameLog *log, const GameRecord *game) {
+   unsigned char body[RECORD_MAX];
+   int length = encodeGame(body, game);
+   if(log->current->used + VARINT_MAX + length > LOG_BUFFER)
+      handOff(log);
+   log->current->used += putVarint(log->current->data + log->current->used, length);
+   memcpy(log->current->data + log->current->used, body, length);
+   log->current->used += length;
+}
+
+/* Writes out what is left and waits for the writer to finish.
+ */
+void logClose(GameLog *log) {
+   LogBuffer *b;
+   if(log->current->used > 0)
+      handOff(log);
+   pthread_mutex_lock(&log->lock);
+   log->closing = 1;
+   pthread_cond_signal(&log->ready);
+   pthread_mutex_unlock(&log->lock);
+   pthread_join(log->thread, NULL);
+   free(log->current);
+   while((b = log->spare) != NULL) {
+      log->spare = b->next;
+      free(b);
+   }
+   if(close(log->fd) == -1) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   free(log);
+}
+
+void logOpen(LogReader *r, const char *path) {
+   struct stat st;
+   int fd = open(path, O_RDONLY);
+   if(fd == -1 || fstat(fd, &st) == -1) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+   r->size = st.st_size;
+   if(r->size < sizeof(LogHeader)) {
+      fprintf(stderr, "%s is not a game log\n", path);
+      exit(EXIT_FAILURE);
+   }
+   r->data = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if(r->data == MAP_FAILED) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+   close(fd);
+   madvise((void *)r->data, r->size, MADV_SEQUENTIAL);
+   memcpy(&r->header, r->data, sizeof(LogHeader));
+   if(memcmp(r->header.magic, LOG_MAGIC, sizeof(r->header.magic))) {
+      fprintf(stderr, "%s is not a game log\n", path);
+      exit(EXIT_FAILURE);
+   }
+   if(r->header.size < SIZE || r->header.size > MAX_SIZE) {
+      fprintf(stderr, "%s holds games on a %ux%u board\n", path, r->header.size,
+         r->header.size);
+      exit(EXIT_FAILURE);
+   }
+   r->end = r->data + r->size;
+   logRewind(r);
+}
+
+void logRewind(LogReader *r) {
+   r->at = r->data + sizeof(LogHeader);
+}
+
+void logRelease(LogReader *r) {
+   munmap((void *)r->data, r->size);
+}
+
+/* Find the next record and read how the game ended. Returns where the record
+ * ends, or NULL at the end of the log. A record cut short by a crash counts
+ * as the end.
+ */
+static const unsigned char *readSummary(LogReader *r, GameSummary *s) {
+   const unsigned char *at = r->at, *end;
+   unsigned long long length;
+   int seat = 0;
+   if(!getVarint(&at, r->end, &length) || length > (unsigned long long)(r->end - at))
+      return NULL;
+   end = at + length;
+   if(at == end)
+      corrupt();
+   s->wins[0] = *at & 1;
+   s->wins[1] = *at >> 1 & 1;
+   s->forfeits[0] = *at >> 2 & 1;
+   s->forfeits[1] = *at++ >> 3 & 1;
+   s->shotCount = nextVarint(&at, end);
+   for(; seat < 2; seat++) {
+      s->hits[seat] = nextVarint(&at, end);
+      s->sinks[seat] = nextVarint(&at, end);
+   }
+   r->at = at;
+   return end;
+}
+
+int logSummary(LogReader *r, GameSummary *summary) {
+   const unsigned char *end = readSummary(r, summary);
+   if(end == NULL)
+      return 0;
+   r->at = end;
+   return 1;
+}
+
+int logNext(LogReader *r, GameRecord *game) {
+   GameSummary s;
+   const unsigned char *end = readSummary(r, &s);
+   unsigned long long v, cells = r->header.size * r->header.size;
+   int i = 0;
+   if(end == NULL)
+      return 0;
+   if(s.shotCount > 2 * cells)
+      corrupt();
+   game->size = r->header.size;
+   memcpy(game->wins, s.wins, sizeof(s.wins));
+   memcpy(game->forfeits, s.forfeits, sizeof(s.forfeits));
+   memcpy(game->hits, s.hits, sizeof(s.hits));
+   memcpy(game->sinks, s.sinks, sizeof(s.sinks));
+   game->shotCount = s.shotCount;
+   decodeBoard(&r->at, end, game->ships[0], game->size);
+   decodeBoard(&r->at, end, game->ships[1], game->size);
+   for(; i < game->shotCount; i++) {
+      v = nextVarint(&r->at, end);
+      if(v < cells) {
+         game->shots[i].row = v / game->size;
+         game->shots[i].col = v % game->size;
+      }
+      else {
+         game->shots[i].row = (v - cells) >> 16;
+         game->shots[i].col = (v - cells) & 0xffff;
+      }
+   }
+   r->at = end;
+   return 1;
+}
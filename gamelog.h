@@ -0,0 +1,84 @@
+#ifndef GAMELOG_H
+#define GAMELOG_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "match.h"
+
+/* A game log is a LogHeader followed by one record per game, appended as the
+ * games end. A record is its length as a varint, then:
+ *
+ *    outcome byte   bit 0 set if the first player won, bit 1 the second,
+ *                   bits 2 and 3 if they forfeited
+ *    varints        shot count, hits and sinks of the first player, hits and
+ *                   sinks of the second
+ *    two boards     a 0 byte and the number placementNumber gives each
+ *                   ship's placement as varints, or a 1 byte and the
+ *                   size*size cells when the board can't be written that way
+ *    the shots      one varint each: row*size+col on the board, and
+ *                   size*size+(row<<16|col) off it
+ *
+ * where size is the size of the board in the header. Shot results aren't
+ * stored since they follow from the boards. On a 10x10 board a shot takes one
+ * byte and a game about 130.
+ */
+#define LOG_MAGIC "BSL1"
+
+typedef struct{
+   char magic[4];
+   unsigned int size;            /* of the board the games are played on */
+   unsigned long long seed;
+   char names[2][MAX_NAME];
+} LogHeader;
+
+/* Games are encoded into buffers of LOG_BUFFER bytes that a thread writes out,
+ * so the game loop never waits for the disk. A new buffer is allocated when
+ * every other one is still waiting to be written.
+ */
+#define LOG_BUFFER (1 << 20)
+
+typedef struct LogBuffer{
+   struct LogBuffer *next;
+   size_t used;
+   unsigned char data[LOG_BUFFER];
+} LogBuffer;
+
+typedef struct{
+   int fd;
+   pthread_t thread;
+   pthread_mutex_t lock;
+   pthread_cond_t ready;
+   LogBuffer *current;
+   LogBuffer *full, *last;       /* waiting to be written, oldest first */
+   LogBuffer *spare;
+   int closing;
+} GameLog;
+
+/* A log mapped into memory. logSummary reads only the start of a record, so
+ * it can skip through games far faster than logNext decodes them.
+ */
+typedef struct{
+   LogHeader header;
+   const unsigned char *data, *at, *end;
+   size_t size;
+} LogReader;
+
+/* How a game ended, without its boards and shots.
+ */
+typedef struct{
+   int shotCount;
+   unsigned int hits[2], sinks[2];
+   int wins[2], forfeits[2];
+} GameSummary;
+
+GameLog *logCreate(const char *path, const LogHeader *header);
+void logGame(GameLog *log, const GameRecord *game);
+void logClose(GameLog *log);
+
+void logOpen(LogReader *r, const char *path);
+int logSummary(LogReader *r, GameSummary *summary);
+int logNext(LogReader *r, GameRecord *game);
+void logRewind(LogReader *r);
+void logRelease(LogReader *r);
+
+#endif
@@ -0,0 +1,101 @@
+#include <string.h>
+#include "histogram.h"
+
+#define HALF (1 << (HIST_BITS - 1))
+
+void histInit(Histogram *h) {
+   memset(h, 0, sizeof(*h));
+   h->min = ~0ULL;
+}
+
+/* Values below 2^HIST_BITS have a bucket each. Above, a value keeps its top
+ * HIST_BITS bits and the power of two it falls in picks the group of HALF
+ * buckets they index.
+ */
+static int bucket(unsigned long long value) {
+   int shift;
+   if(value < (1 << HIST_BITS))
+      return value;
+   shift = 63 - __builtin_clzll(value) - HIST_BITS + 1;
+   return (1 << HIST_BITS) + (shift - 1) * HALF + (int)(value >> shift) - HALF;
+}
+
+/* Middle of the values that land in a bucket.
+ */
+static unsigned long long bucketValue(int i) {
+   int shift;
+   if(i < (1 << HIST_BITS))
+      return i;
+   i -= 1 << HIST_BITS;
+   shift = i / HALF + 1;
+   return ((unsigned long long)(i % HALF + HALF) << shift) + (1ULL << (shift - 1));
+}
+
+void histAdd(Histogram *h, unsigned long long value) {
+   h->counts[bucket(value)]++;
+   h->total++;
+   h->sum += value;
+   if(value < h->min)
+      h->min = value;
+   if(value > h->max)
+      h->max = value;
+}
+
+void histMerge(Histogram *into, const Histogram *from) {
+   int i = 0;
+   for(; i < HIST_BUCKETS; i++)
+      into->counts[i] += from->counts[i];
+   into->total += from->total;
+   into->sum += from->sum;
+   if(from->min < into->min)
+      into->min = from->min;
+   if(from->max > into->max)
+      into->max = from->max;
+}
+
+/* The value at or below which percent of the values lie, clamped to the
+ * smallest and largest values seen. The value is the one of nearest rank,
+ * ceil(percent / 100 * total) counted from 1, so the median of two values is
+ * the smaller. 0 for an empty histogram.
+ */
+unsigned long long histPercentile(const Histogram *h, double percent) {
+   double exact = percent * h->total / 100.0;
+   unsigned long long rank = (unsigned long long)exact, seen = 0, value;
+   int i = 0;
+   if(h->total == 0)
+      return 0;
+   rank += rank < exact;         // rounded up
+   rank = rank > 0 ? rank - 1 : 0;
+   if(rank >= h->total)
+      rank = h->total - 1;
+   for(; i < HIST_BUCKETS; i++) {
+      seen += h->counts[i];
+      if(seen > rank)
+         break;
+   }
+   value = bucketValue(i);
+   return value < h->min ? h->min : value > h->max ? h->max : value;
+}
+
+double histMean(const Histogram *h) {
+   return h->total ? (double)h->sum / h->total : 0.0;
+}
+
+/* Write the histogram as a JSON object holding its summary and the value and
+ * count of every bucket that isn't empty.
+ */
+void histWriteJson(FILE *out, const Histogram *h) {
+   int i = 0, first = 1;
+   fprintf(out, "{\"count\":%llu,\"mean_ns\":%.1f,\"min_ns\":%llu,", h->total,
+      histMean(h), h->total ? h->min : 0);
+   fprintf(out, "\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu,",
+      histPercentile(h, 50.0), histPercentile(h, 99.0), histPercentile(h, 99.9), h->max);
+   fprintf(out, "\"buckets\":[");
+   for(; i < HIST_BUCKETS; i++) {
+      if(h->counts[i] == 0)
+         continue;
+      fprintf(out, "%s[%llu,%llu]", first ? "" : ",", bucketValue(i), h->counts[i]);
+      first = 0;
+   }
+   fprintf(out, "]}");
+}
@@ -0,0 +1,33 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdio.h>
+#include <time.h>
+
+/* Histogram of durations in nanoseconds with HDR-style buckets: exact below
+ * 2^HIST_BITS, then 2^(HIST_BITS-1) buckets per power of two, so any value is
+ * within about 3% of the bucket it lands in. Adding a value is a few
+ * instructions and histograms of the same kind can simply be merged.
+ */
+#define HIST_BITS 5
+#define HIST_BUCKETS ((1 << HIST_BITS) + (64 - HIST_BITS) * (1 << (HIST_BITS - 1)))
+
+typedef struct{
+   unsigned long long counts[HIST_BUCKETS];
+   unsigned long long total, sum, min, max;
+} Histogram;
+
+static inline long long monotonicNs(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void histInit(Histogram *h);
+void histAdd(Histogram *h, unsigned long long value);
+void histMerge(Histogram *into, const Histogram *from);
+unsigned long long histPercentile(const Histogram *h, double percent);
+double histMean(const Histogram *h);
+void histWriteJson(FILE *out, const Histogram *h);
+
+#endif
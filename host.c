@@ -1,360 +1,468 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <sys/types.h>
-#include <unistd.h>
 #include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
 #include "battleship.h"
+#include "match.h"
+#include "gamelog.h"
+#include "arena.h"
+#include "results.h"
 
-#define MAX_FD 4
-#define MAX_NAME 20
-
-/* Struct used to keep track of various stats.
+/* Options given on the command line.
  */
 typedef struct{
-   unsigned int wins, losses, draws, hits, misses, sinks;
-} Score;
+   unsigned long long games;     /* games per match */
+   unsigned long long interval;  /* games between totals in quiet mode, 0 for none */
+   int quiet;                    /* no output per game */
+   int shm;                      /* shared memory instead of pipes */
+   unsigned long long seed;      /* seed the players' seeds come from */
+   char *record, *replay;        /* files to record the match to or replay it from */
+   char *timings;                /* file to write the players' response times to */
+   char *stats;                  /* file to write the players' heatmaps and shot counts to */
+   long long moveNs, matchNs;    /* time a player has per answer and per match, 0 for no limit */
+   int matches;                  /* matches played at once by one thread, 0 for just one */
+   int simultaneous;             /* both players shoot at once */
+   int size;                     /* of the board, from SIZE to MAX_SIZE */
+   char *results;                /* file to write a record of each game and match to */
+   int csv;                      /* records as CSV rather than JSON lines */
+   long long flushNs;            /* longest time between writes of the records */
+} Options;
 
-/* Struct used in determining which parts of a ship is hit and when it is sunk.
+/* Where the games of the match are logged to or replayed from, if anywhere.
+ * game holds the game being logged or replayed.
  */
 typedef struct{
-   int shotAC, shotB, shotD, shotS, shotPB;
-   Shot AC[SIZE_AIRCRAFT_CARRIER];
-   Shot B[SIZE_AIRCRAFT_CARRIER];
-   Shot D[SIZE_AIRCRAFT_CARRIER];
-   Shot S[SIZE_AIRCRAFT_CARRIER];
-   Shot PB[SIZE_AIRCRAFT_CARRIER];
-} HitCounter;
+   GameLog *log;
+   LogReader reader;
+   int replay;
+   GameRecord game;
+} Recording;
+
+static const struct option longOptions[] = {
+   {"seed", required_argument, NULL, 'S'},
+   {"record", required_argument, NULL, 'r'},
+   {"replay", required_argument, NULL, 'R'},
+   {"timings", required_argument, NULL, 't'},
+   {"move-deadline", required_argument, NULL, 'm'},
+   {"match-deadline", required_argument, NULL, 'M'},
+   {"matches", required_argument, NULL, 'n'},
+   {"simultaneous", no_argument, NULL, 'p'},
+   {"board", required_argument, NULL, 'b'},
+   {"results", required_argument, NULL, 'o'},
+   {"csv", no_argument, NULL, 'c'},
+   {"flush", required_argument, NULL, 'F'},
+   {"stats", required_argument, NULL, 'H'},
+   {NULL, 0, NULL, 0}
+};
 
 static void printFileUsage() {
-   fprintf(stderr, "Usage: battleship player1 player2\n");
+   fprintf(stderr, "Usage: battleship [-g games] [-q [-i interval]] [-s] [-S seed] ");
+   fprintf(stderr, "[-r file] [-t file]\n                  [-m ms] [-M ms] [-p] [-b size] ");
+   fprintf(stderr, "[-o file [-c] [-F ms]] [-H file]\n                  player1 player2\n");
+   fprintf(stderr, "       battleship [-q [-i interval]] [-o file [-c] [-F ms]] [-H file] -R file\n");
+   fprintf(stderr, "       battleship -n matches [-g games] [-S seed] [-t file] [-m ms] [-M ms] [-p]\n");
+   fprintf(stderr, "                  [-b size] [-o file [-c] [-F ms]] [-H file] player1 player2\n");
+   fprintf(stderr, "\t-g\tnumber of games in the match (default %d)\n", GAMES);
+   fprintf(stderr, "\t-q\tprint only the totals, not each game\n");
+   fprintf(stderr, "\t-i\tin quiet mode, also print the totals every interval games\n");
+   fprintf(stderr, "\t-s\ttalk to process players through shared memory\n");
+   fprintf(stderr, "\t-S, --seed\tseed given to the players (default from the clock)\n");
+   fprintf(stderr, "\t-r, --record\tlog the boards, shots and results of the match to file\n");
+   fprintf(stderr, "\t-R, --replay\tplay a recorded match again without the players\n");
+   fprintf(stderr, "\t-t, --timings\twrite the players' response time histograms to file\n");
+   fprintf(stderr, "\t-m, --move-deadline\tmilliseconds a player has for each answer\n");
+   fprintf(stderr, "\t-M, --match-deadline\tmilliseconds a player has for all its answers\n");
+   fprintf(stderr, "\t-n, --matches\tplay that many matches at once and print their totals\n");
+   fprintf(stderr, "\t-p, --simultaneous\task both players for their shots at once\n");
+   fprintf(stderr, "\t-b, --board\tplay on a size x size board, %d to %d (default %d)\n",
+      SIZE, MAX_SIZE, SIZE);
+   fprintf(stderr, "\t-o, --results\twrite a JSON line for each game and match to file\n");
+   fprintf(stderr, "\t-c, --csv\twrite the results as CSV instead\n");
+   fprintf(stderr, "\t-F, --flush\tmilliseconds between writes of the results (default %d)\n",
+      FLUSH_MS);
+   fprintf(stderr, "\t-H, --stats\twrite the players' shot and ship heatmaps and how many\n");
+   fprintf(stderr, "\t\tshots their first hit, first sink and win took to file\n");
+   fprintf(stderr, "A player that misses a deadline, dies or answers nonsense forfeits the game.\n");
+   fprintf(stderr, "A player ending in .so[:args] is loaded as a plugin.\n");
    exit(EXIT_FAILURE);
 }
 
-static void closeEnd(int fd) {
-   if(close(fd) == -1) {
-      perror(NULL);
-      exit(EXIT_FAILURE);
-   }
+static void printGameResults(unsigned long long game, int aWin, int bWin,
+   Score *a, Score *b, char *nA, char *nB, int size) {
+   int shots = a->hits + a->misses;
+   printf("\nGame %llu Results: ", game);
+   if(a->forfeited && b->forfeited)
+      printf("Both players forfeited\n");
+   else if(a->forfeited || b->forfeited)
+      printf("%s forfeited, %s won!\n", a->forfeited ? nA : nB, a->forfeited ? nB : nA);
+   else if(aWin && bWin)
+      printf("Draw\n");
+   else if(aWin)
+      printf("%s won!\n", nA);
+   else if(bWin)
+      printf("%s won!\n", nB);
+   else
+      printf("No winner within %d shots\n", size * size);
+   printf("%16s: %d shots, %d hits, and ", nA, shots, a->hits);
+   printf("%d sinks\n", a->sinks);
+   printf("%16s: %d shots, %d hits, and ", nB, shots, b->hits);
+   printf("%d sinks\n", b->sinks);
 }
 
-void setupPipe(int *fd, int write, char *arg) {
-   if(pipe(fd)) {
-      perror(NULL);
-      exit(EXIT_FAILURE);
+static void printMatchResults(Score a, Score b, char *nA, char *nB) {
+   printf("\nMatch Results: ");
+   if(a.wins > b.wins)
+      printf("%s won!\n", nA);
+   else
+      printf("%s won!\n", nB);
+   printf("%16s: %llu wins, %llu draws, and ", nA, a.wins, a.draws);
+   printf("%llu losses\n", a.losses);
+   printf("%16s: %llu wins, %llu draws, and ", nB, b.wins, b.draws);
+   printf("%llu losses\n", b.losses);
+   if(a.forfeits || b.forfeits) {
+      printf("%16s: %llu forfeits\n", nA, a.forfeits);
+      printf("%16s: %llu forfeits\n", nB, b.forfeits);
    }
-   if(!write)
-      sprintf(arg, "%d", fd[0]);
-   else 
-      sprintf(arg, "%d", fd[1]);
 }
 
-/* Set up the host by closing the pipe ends that aren't used.
- */
-void setupHost(int close1, int close2, int close3, int close4) {
-   closeEnd(close1);
-   closeEnd(close2);
-   closeEnd(close3);
-   closeEnd(close4);
+static void printTime(const char *name, const char *kind, const Histogram *h) {
+   printf("%16s %6s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, kind, h->total,
+      histMean(h) / 1e3, histPercentile(h, 50.0) / 1e3, histPercentile(h, 99.0) / 1e3,
+      histPercentile(h, 99.9) / 1e3, h->max / 1e3);
 }
 
-/* Set up a player by closing pipe ends that aren't used and then executing the player.
+/* Prints how long each player took to answer for shots and boards.
  */
-void setupPlayer(char **args, int index, char *rfd, char *wfd,
-   int close1, int close2, int close34[2], int close56[2]) {
-   pid_t pid;
-   if((pid = fork()) < 0)
-      perror(NULL);
-   else if(pid == 0) {
-      closeEnd(close1);
-      closeEnd(close2);
-      closeEnd(close34[0]);
-      closeEnd(close34[1]);
-      closeEnd(close56[0]);
-      closeEnd(close56[1]);
-      execl(args[index], args[index], rfd, wfd, (char *)0);
-      perror(NULL);
-      exit(EXIT_FAILURE);
-   }
-}
-
-
-static Score setupScore() {
-   Score temp;
-   temp.wins = temp.losses = temp.draws = 0;
-   temp.hits = temp.misses = temp.sinks = 0;
-   return temp;
+static void printTimes(Timing *a, Timing *b, char *nA, char *nB) {
+   printf("\nResponse Times (microseconds):\n");
+   printf("%16s %6s %10s %10s %10s %10s %10s %10s\n", "", "", "count", "mean",
+      "p50", "p99", "p999", "max");
+   printTime(nA, "shot", &a->think);
+   printTime(nA, "board", &a->board);
+   printTime(nB, "shot", &b->think);
+   printTime(nB, "board", &b->board);
 }
 
-static HitCounter setupHit() {
-   HitCounter temp;
-   temp.shotAC = temp.shotB = temp.shotD = temp.shotS = temp.shotPB = 0;
-   return temp;
+static void writeTime(FILE *out, const char *name, int seat, const char *kind,
+   const Histogram *h) {
+   fprintf(out, "{\"player\":\"%s\",\"seat\":%d,\"kind\":\"%s\",\"histogram\":",
+      name, seat, kind);
+   histWriteJson(out, h);
+   fprintf(out, "}\n");
 }
 
-static void writeTo(int fd, int msg) {
-   if(sizeof(int) != write(fd, &msg, sizeof(int))) {
-      fprintf(stderr, "write failure in %s at line %d\n", __FILE__, __LINE__);
-      exit(EXIT_FAILURE);
-   }
-}
-
-/* Extract the names of the players from the arguments provided.
+/* Writes the histograms as JSON lines, one per player and kind of answer.
  */
-static void getName(char (*name)[MAX_NAME], char *arg) {
-   int index = strlen(arg) - 1, i = 0;
-   if(strchr(arg, '/') == NULL) {
-      for(; i < strlen(arg); i++)
-         (*name)[i] = arg[i];
+static void writeTimes(char *path, Timing *a, Timing *b, char *nA, char *nB) {
+   FILE *out = fopen(path, "w");
+   if(out == NULL) {
+      perror(path);
+      exit(EXIT_FAILURE);
    }
-   else {
-      while(arg[index] != '/')
-         index--;
-      index++;
-      for(; index < strlen(arg); index++) {
-         (*name)[i] = arg[index];
-         i++;
-      }
+   writeTime(out, nA, 0, "shot", &a->think);
+   writeTime(out, nA, 0, "board", &a->board);
+   writeTime(out, nB, 1, "shot", &b->think);
+   writeTime(out, nB, 1, "board", &b->board);
+   if(fclose(out)) {
+      perror(path);
+      exit(EXIT_FAILURE);
    }
-   (*name)[i] = '\0';
 }
 
-static void writeShot(int fd, Shot shot) {
-   if(sizeof(Shot) != write(fd, &shot, sizeof(Shot))) {
-      fprintf(stderr, "write failure in %s at line %d\n", __FILE__, __LINE__);
-      exit(EXIT_FAILURE);
-   }
+static void writeStat(FILE *out, const char *name, int seat, const Stats *s) {
+   fprintf(out, "{\"player\":\"%s\",\"seat\":%d,\"stats\":", name, seat);
+   statsWriteJson(out, s);
+   fprintf(out, "}\n");
 }
 
-/* Read in a board and store it.
+/* Writes the stats of both players as JSON lines, one per player.
  */
-static void readBoard(int fd, char (*board)[SIZE][SIZE]) {
-   int bytesRead = 0, i = 0, j = 0;
-   char temp;
-   for(; bytesRead < (SIZE*SIZE); bytesRead++) {
-      if(1 != read(fd, &temp, 1)) {
-         fprintf(stderr, "read failure in %s at line %d\n", __FILE__, __LINE__);
-         exit(EXIT_FAILURE);
-      }      
-      (*board)[i][j] = temp;
-      if(j < (SIZE-1))
-         j++;
-      else {
-         i++;
-         j = 0;
-      }
+static void writeStats(char *path, Stats *a, Stats *b, char *nA, char *nB) {
+   FILE *out = fopen(path, "w");
+   if(out == NULL) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+   writeStat(out, nA, 0, a);
+   writeStat(out, nB, 1, b);
+   if(fclose(out)) {
+      perror(path);
+      exit(EXIT_FAILURE);
    }
 }
 
-static int outOfBounds(Shot s) {
-   return (s.row >= SIZE || s.row < 0 || s.col >= SIZE || s.col < 0);
+static void printScoreTotals(Score *s, char *name) {
+   printf("%16s: %llu wins, %llu draws, %llu losses, ", name, s->wins,
+      s->draws, s->losses);
+   if(s->forfeits)
+      printf("%llu forfeits, ", s->forfeits);
+   printf("%llu hits, %llu misses, %llu sinks\n", s->totalHits,
+      s->totalMisses, s->totalSinks);
 }
 
-/* Comparator for shots based on their row and col values.
- */      
-static int compareShots(Shot a, Shot b) {
-   if(a.row == b.row && a.col == b.col)
-      return 0;
-   return 1;
-}  
-
-/* Check to see if the shot sunk a particular ship.
+/* Prints the totals of both players so far, used instead of the results of
+ * every game in quiet mode.
  */
-static int shipCheck(Shot s, int size, int shot, Shot (*shotShip)[5]) {
-   int i = 0;
-   if(shot == size)     // if the ship is already sunk, return a hit
-      return HIT;
-   for(; i <= shot; i++) {
-      if(compareShots(s, (*shotShip)[i])) {
-         (*shotShip)[shot] = s;
-         shot++;
-         if(shot == size) 
-            return SINK;
-         return HIT;
-      }
-   }
-   return HIT;
+static void printTotals(unsigned long long games, Score *a, Score *b,
+   char *nA, char *nB) {
+   printf("\nTotals after %llu games:\n", games);
+   printScoreTotals(a, nA);
+   printScoreTotals(b, nB);
+   fflush(stdout);
 }
 
-
-/* Redirects into the previous function with the proper parameters.
+/* Plays the match and prints the results of each game as it goes, writing
+ * them to res as well unless it is NULL.
  */
-static int checkSink(HitCounter *h, Shot s, int hit) {
-   int i;
-   if(hit == AIRCRAFT_CARRIER) {
-      i = shipCheck(s, SIZE_AIRCRAFT_CARRIER, (*h).shotAC, &((*h).AC));
-      if(i == SINK || (i == HIT && (*h).shotAC != SIZE_AIRCRAFT_CARRIER))
-         (*h).shotAC++;
-   }
-   else if(hit == BATTLESHIP) {
-      i = shipCheck(s, SIZE_BATTLESHIP, (*h).shotB, &((*h).B));
-      if(i == SINK || (i == HIT && (*h).shotB != SIZE_BATTLESHIP))
-         (*h).shotB++;
-   }
-   else if(hit == DESTROYER) {
-      i = shipCheck(s, SIZE_DESTROYER, (*h).shotD, &((*h).D));
-      if(i == SINK || (i == HIT && (*h).shotD != SIZE_DESTROYER))
-         (*h).shotD++;
-   }
-   else if(hit == SUBMARINE) {
-      i = shipCheck(s, SIZE_SUBMARINE, (*h).shotS, &((*h).S));
-      if(i == SINK || (i == HIT && (*h).shotS != SIZE_SUBMARINE))
-         (*h).shotS++;
+static void gameLoop(Player *a, Player *b, Score *sa, Score *sb, char *nameA,
+   char *nameB, Options *opt, Recording *rec, Results *res) {
+   unsigned long long i = 0;
+   int winAB[2];
+   for(; i < opt->games; i++) {    // plays the amount of games asked for
+      if(!opt->quiet)
+         printf("\nGame %llu:\n", i+1);
+      if(rec->replay)
+         logNext(&rec->reader, &rec->game);
+      playGame(a, b, sa, sb, &winAB, rec->log ? &rec->game : NULL,
+         opt->simultaneous);
+      if(rec->log)
+         logGame(rec->log, &rec->game);
+      if(!opt->quiet)
+         printGameResults(i+1, winAB[0], winAB[1], sa, sb, nameA, nameB, opt->size);
+      if(res)
+         resultsGame(res, 0, i+1, opt->seed, &winAB, sa, sb);
+      endGame(sa);
+      endGame(sb);
+      if(opt->quiet && opt->interval && (i+1) % opt->interval == 0 && i+1 < opt->games)
+         printTotals(i+1, sa, sb, nameA, nameB);
    }
-   else{
-      i = shipCheck(s, SIZE_PATROL_BOAT, (*h).shotPB, &((*h).PB));
-      if(i == SINK || (i == HIT && (*h).shotPB != SIZE_PATROL_BOAT))
-         (*h).shotPB++;
-   }
-   return i;
+   endMatch(a);
+   endMatch(b);
 }
 
-/* Checks for a win based on the amount of sinks.
- */
-static void checkWin(int (*wins)[2], Score *a, Score *b) {
-   (*wins)[0] = (*wins)[1] = 0;
-   if(a->sinks == 5 && b->sinks == 5) {   // draw when both players win on their last shot
-      a->draws++;
-      b->draws++;
-      (*wins)[0] = (*wins)[1] = 1;
-   }
-   else if(a->sinks == 5) {
-      a->wins++;
-      b->losses++;
-      (*wins)[0] = 1;
-   }
-   else if(b->sinks == 5) {
-      a->losses++;
-      b->wins++;
-      (*wins)[1] = 1;
-   }
-   else {      // both lose if no one sinks all the ships
-      a->losses++;
-      b->losses++;
+static Options getOptions(int argc, char **argv) {
+   Options opt;
+   char *end;
+   int c;
+   opt.games = GAMES;
+   opt.interval = 0;
+   opt.quiet = opt.shm = 0;
+   opt.seed = (unsigned long long)time(NULL) << 20 ^ getpid();
+   opt.record = opt.replay = opt.timings = opt.stats = NULL;
+   opt.moveNs = opt.matchNs = 0;
+   opt.matches = opt.simultaneous = 0;
+   opt.size = 0;
+   opt.results = NULL;
+   opt.csv = 0;
+   opt.flushNs = FLUSH_MS * 1000000LL;
+   while((c = getopt_long(argc, argv, "g:qi:sS:r:R:t:m:M:n:pb:o:cF:H:", longOptions, NULL)) != -1) {
+      if(c == 'g')
+         opt.games = getCount(optarg, printFileUsage);
+      else if(c == 'q')
+         opt.quiet = 1;
+      else if(c == 'i')
+         opt.interval = getCount(optarg, printFileUsage);
+      else if(c == 's')
+         opt.shm = 1;
+      else if(c == 'S') {
+         opt.seed = strtoull(optarg, &end, 10);
+         if(*optarg == '-' || *end != '\0')
+            printFileUsage();
+      }
+      else if(c == 'r')
+         opt.record = optarg;
+      else if(c == 'R')
+         opt.replay = optarg;
+      else if(c == 't')
+         opt.timings = optarg;
+      else if(c == 'm')
+         opt.moveNs = getCount(optarg, printFileUsage) * 1000000LL;
+      else if(c == 'M')
+         opt.matchNs = getCount(optarg, printFileUsage) * 1000000LL;
+      else if(c == 'n')
+         opt.matches = getCount(optarg, printFileUsage);
+      else if(c == 'p')
+         opt.simultaneous = 1;
+      else if(c == 'b') {
+         opt.size = getCount(optarg, printFileUsage);
+         if(opt.size < SIZE || opt.size > MAX_SIZE)
+            printFileUsage();
+      }
+      else if(c == 'o')
+         opt.results = optarg;
+      else if(c == 'c')
+         opt.csv = 1;
+      else if(c == 'H')
+         opt.stats = optarg;
+      else if(c == 'F') {
+         opt.flushNs = strtoll(optarg, &end, 10) * 1000000LL;
+         if(*optarg == '-' || *end != '\0')
+            printFileUsage();
+      }
+      else
+         printFileUsage();
    }
+   if(argc - optind != (opt.replay ? 0 : 2) ||
+      (opt.replay && (opt.record || opt.timings || opt.moveNs || opt.matchNs || opt.size)) ||
+      (opt.matches && (opt.replay || opt.record || opt.shm || opt.interval)) ||
+      (opt.csv && !opt.results))
+      printFileUsage();
+   if(opt.size == 0)
+      opt.size = SIZE;
+   return opt;
 }
 
-static void printGameResults(int game, int aWin, int bWin, 
-   Score *a, Score *b, char *nA, char *nB) {
-   int shots = a->hits + a->misses;
-   sleep(0.5);
-   printf("\nGame %d Results: ", game);
-   if(aWin && bWin)
-      printf("Draw\n");
-   else if(aWin)
-      printf("%s won!\n", nA);
-   else if(bWin)
-      printf("%s won!\n", nB);
-   else
-      printf("No winner within %d shots\n", MAX_SHOTS);
-   printf("%16s: %d shots, %d hits, and ", nA, shots, a->hits);
-   printf("%d sinks\n", a->sinks);
-   printf("%16s: %d shots, %d hits, and ", nB, shots, b->hits);
-   printf("%d sinks\n", b->sinks);
-}
-
-static void printMatchResults(Score a, Score b, char *nA, char *nB) {
-   printf("\nMatch Results: ");
-   if(a.wins > b.wins)
-      printf("%s won!\n", nA);
-   else
-      printf("%s won!\n", nB);
-   printf("%16s: %d wins, %d draws, and ", nA, a.wins, a.draws);
-   printf("%d losses\n", a.losses);
-   printf("%16s: %d wins, %d draws, and ", nB, b.wins, b.draws);
-   printf("%d losses\n", b.losses);
-}
-
-/* Determines the shot's results and increments the correct stats.
- * Also writes the results and proper signals to players.
+/* Sets up both players to replay a game log, and takes the names, the number
+ * of games and the seed from it.
  */
-static void processShot(int rfd, int wfd1, int wfd2, Score *score,
-   HitCounter *h, char board[SIZE][SIZE], char *name) {
-   Shot shot;
-   int result;
-   if(sizeof(Shot) != read(rfd, &shot, sizeof(Shot))) {
-      fprintf(stderr, "read failure in %s at line %d\n", __FILE__, __LINE__);
+static void setupReplays(Player *a, Player *b, char *nA, char *nB, Options *opt,
+   Recording *rec) {
+   GameSummary summary;
+   logOpen(&rec->reader, opt->replay);
+   memcpy(nA, rec->reader.header.names[0], MAX_NAME);
+   memcpy(nB, rec->reader.header.names[1], MAX_NAME);
+   nA[MAX_NAME - 1] = nB[MAX_NAME - 1] = '\0';
+   opt->seed = rec->reader.header.seed;
+   opt->size = rec->reader.header.size;
+   for(opt->games = 0; logSummary(&rec->reader, &summary); opt->games++)
+      ;
+   logRewind(&rec->reader);
+   if(opt->games == 0) {
+      fprintf(stderr, "%s holds no games\n", opt->replay);
       exit(EXIT_FAILURE);
    }
-   if(outOfBounds(shot)) {
-      result = MISS;
-      score->misses++;
-   }
-   else if(board[shot.row][shot.col] == OPEN_WATER) {
-      result = MISS;
-      score->misses++;
-   }
-   else {
-      result = checkSink(h, shot, board[shot.row][shot.col]);
-      if(result == HIT)
-         score->hits++;
-      else {
-         score->hits++;
-         score->sinks++;
-      }
-   }
-   writeTo(wfd1, SHOT_RESULT);
-   writeTo(wfd1, result);
-   writeTo(wfd2, OPPONENTS_SHOT);
-   writeShot(wfd2, shot);
+   rec->replay = 1;
+   setupReplay(a, &rec->game, 0);
+   setupReplay(b, &rec->game, 1);
+}
+
+static void setupLog(char *nA, char *nB, Options *opt, Recording *rec) {
+   LogHeader h;
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, LOG_MAGIC, sizeof(h.magic));
+   h.size = opt->size;
+   h.seed = opt->seed;
+   snprintf(h.names[0], MAX_NAME, "%s", nA);
+   snprintf(h.names[1], MAX_NAME, "%s", nB);
+   rec->log = logCreate(opt->record, &h);
 }
-/* Main game logic: sends out signals and reads in the responses.
+
+/* Plays opt->matches matches at once and prints their totals.
  */
-static void gameLoop(int ar, int aw, int br, int bw, Score *sa,
-   Score *sb, char *nameA, char *nameB) {
-   char boardA[SIZE][SIZE], boardB[SIZE][SIZE];
-   HitCounter hitA, hitB;
-   int i = 0, shots, winAB[2];
-   for(; i < GAMES; i++) {    // plays the amount of games specified in battleship.h
-      shots = 0;
-      hitA = setupHit();
-      hitB = setupHit();
-      writeTo(aw, NEW_GAME);
-      readBoard(ar, &boardA);
-      writeTo(bw, NEW_GAME);
-      readBoard(br, &boardB);
-      printf("\nGame %d:\n", i+1);
-      while(shots < MAX_SHOTS) {
-         writeTo(aw, SHOT_REQUEST);
-         processShot(ar, aw, bw, sa, &hitA, boardB, nameA);
-         writeTo(bw, SHOT_REQUEST);
-         processShot(br, bw, aw, sb, &hitB, boardA, nameB);
-         shots++;
-         if((*sa).sinks == 5 || (*sb).sinks == 5)
-            break;
-      }
-      checkWin(&winAB, sa, sb);
-      printGameResults(i+1, winAB[0], winAB[1], sa, sb, nameA, nameB);
-      sa->hits = sa->misses = sa->sinks = sb->hits = sb->misses = sb->sinks = 0;
-      winAB[0] = winAB[1] = 0;
+static void runArena(char **argv, Options *opt) {
+   Arena a;
+   Timing tA, tB;
+   char nA[MAX_NAME], nB[MAX_NAME];
+   getName(&nA, argv[1]);
+   getName(&nB, argv[2]);
+   a.args[0] = argv[1];
+   a.args[1] = argv[2];
+   a.matches = opt->matches;
+   a.simultaneous = opt->simultaneous;
+   a.size = opt->size;
+   a.games = opt->games;
+   a.seed = opt->seed;
+   a.moveNs = opt->moveNs;
+   a.matchNs = opt->matchNs;
+   histInit(&tA.think);
+   histInit(&tA.board);
+   histInit(&tB.think);
+   histInit(&tB.board);
+   a.timing[0] = &tA;
+   a.timing[1] = &tB;
+   a.stats[0] = opt->stats ? statsCreate(opt->size) : NULL;
+   a.stats[1] = opt->stats ? statsCreate(opt->size) : NULL;
+   a.results = opt->results ? resultsCreate(opt->results, opt->csv, opt->flushNs, nA, nB,
+      opt->size) : NULL;
+   printf("Seed: %llu\n", opt->seed);
+   fflush(stdout);
+   arenaRun(&a);
+   if(a.results)
+      resultsClose(a.results);
+   printTotals(opt->games * opt->matches, &a.scores[0], &a.scores[1], nA, nB);
+   printMatchResults(a.scores[0], a.scores[1], nA, nB);
+   printTimes(&tA, &tB, nA, nB);
+   if(opt->timings)
+      writeTimes(opt->timings, &tA, &tB, nA, nB);
+   if(opt->stats) {
+      writeStats(opt->stats, a.stats[0], a.stats[1], nA, nB);
+      free(a.stats[0]);
+      free(a.stats[1]);
    }
-   writeTo(aw, MATCH_OVER);
-   writeTo(bw, MATCH_OVER);
 }
 
-/* Calls most of the setup for pipes, players and data structures.
- * There is 2 sets of pipes per player: read and write.
- * The unused ends for the host and players need to be closed. 
+/* Calls the setup for the players and data structures, then plays the match.
  */
 int main(int argc, char **argv) {
    Score sA, sB;
-   int fdA1[2], fdA2[2], fdB1[2], fdB2[2];
-   char rfdA[MAX_FD], wfdA[MAX_FD], nA[MAX_NAME];
-   char rfdB[MAX_FD], wfdB[MAX_FD], nB[MAX_NAME];
-   if(argc != 3)
-      printFileUsage();
-   getName(&nA, argv[1]);
-   getName(&nB, argv[2]);
-   setupPipe(fdA1, 0, rfdA);
-   setupPipe(fdA2, 1, wfdA);
-   setupPipe(fdB1, 0, rfdB);
-   setupPipe(fdB2, 1, wfdB);
-   setupPlayer(argv, 1, rfdA, wfdA, fdA1[1], fdA2[0], fdB1, fdB2);
-   setupPlayer(argv, 2, rfdB, wfdB, fdB1[1], fdB2[0], fdA1, fdA2);
-   setupHost(fdA1[0], fdA2[1], fdB1[0], fdB2[1]);
+   Player pA, pB;
+   Options opt;
+   MatchStart startA, startB;
+   Timing tA, tB;
+   Recording rec;
+   Results *res = NULL;
+   char nA[MAX_NAME], nB[MAX_NAME];
+   opt = getOptions(argc, argv);
+   argv += optind - 1;
+   signal(SIGPIPE, SIG_IGN);
+   if(opt.matches) {
+      runArena(argv, &opt);
+      exit(EXIT_SUCCESS);
+   }
+   rec.log = NULL;
+   rec.replay = 0;
+   if(opt.replay)
+      setupReplays(&pA, &pB, nA, nB, &opt, &rec);
+   else {
+      getName(&nA, argv[1]);
+      getName(&nB, argv[2]);
+      startA = seatStart(opt.seed, 0, opt.size);
+      startB = seatStart(opt.seed, 1, opt.size);
+      nameOpponent(&startA, argv[2]);
+      nameOpponent(&startB, argv[1]);
+      setupPlayer(&pA, argv[1], opt.shm, &startA);
+      setupPlayer(&pB, argv[2], opt.shm, &startB);
+      setupDeadlines(&pA, opt.moveNs, opt.matchNs);
+      setupDeadlines(&pB, opt.moveNs, opt.matchNs);
+      histInit(&tA.think);
+      histInit(&tA.board);
+      histInit(&tB.think);
+      histInit(&tB.board);
+      pA.timing = &tA;
+      pB.timing = &tB;
+      if(opt.record)
+         setupLog(nA, nB, &opt, &rec);
+   }
+   if(opt.stats) {
+      pA.stats = statsCreate(opt.size);
+      pB.stats = statsCreate(opt.size);
+   }
+   if(opt.results)
+      res = resultsCreate(opt.results, opt.csv, opt.flushNs, nA, nB, opt.size);
+   printf("Seed: %llu\n", opt.seed);
    sA = setupScore();
    sB = setupScore();
-   gameLoop(fdA2[0], fdA1[1], fdB2[0], fdB1[1], &sA, &sB, nA, nB);
+   gameLoop(&pA, &pB, &sA, &sB, nA, nB, &opt, &rec, res);
+   if(res) {
+      resultsMatch(res, 0, opt.games, opt.seed, &sA, &sB);
+      resultsClose(res);
+   }
+   if(rec.log)
+      logClose(rec.log);
+   if(rec.replay)
+      logRelease(&rec.reader);
+   if(opt.quiet)
+      printTotals(opt.games, &sA, &sB, nA, nB);
    printMatchResults(sA, sB, nA, nB);
+   if(!rec.replay) {
+      printTimes(&tA, &tB, nA, nB);
+      if(opt.timings)
+         writeTimes(opt.timings, &tA, &tB, nA, nB);
+   }
+   if(opt.stats)
+      writeStats(opt.stats, pA.stats, pB.stats, nA, nB);
    exit(EXIT_SUCCESS);
 }
-
@@ -0,0 +1,813 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include "match.h"
+#include "placements.h"
+#include "rng.h"
+
+#define MAX_FD 12
+
+/* Extra time a process has for its first answer, since it has to start up,
+ * and how often the host checks whether a player has exited at the end of a
+ * match.
+ */
+#define STARTUP_NS 1000000000LL
+#define EXIT_POLL_NS 1000000
+
+static void closeEnd(int fd) {
+   if(close(fd) == -1) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/* The host's ends are closed on exec so players started from other threads
+ * don't inherit them. The player clears the flag on its own end.
+ */
+static void setupPipe(int *fd, int write, char *arg) {
+   if(pipe2(fd, O_CLOEXEC)) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   if(!write)
+      sprintf(arg, "%d", fd[0]);
+   else 
+      sprintf(arg, "%d", fd[1]);
+}
+
+/* Set up a process player by executing it with the player ends of its pipes.
+ * The host keeps one pipe to write to the player and one to read from it.
+ * With shm the player gets the shared memory rings instead of the pipes.
+ */
+static void setupProcess(Player *p, char *path, int shm, const MatchStart *start) {
+   int toPlayer[2], fromPlayer[2], memFD;
+   char rfd[MAX_FD], wfd[MAX_FD];
+   pid_t pid;
+   if(shm) {
+      p->rings = ringCreate(&memFD);
+      strcpy(rfd, SHM_ARG);
+      sprintf(wfd, "%d", memFD);
+   }
+   else {
+      p->rings = NULL;
+      setupPipe(toPlayer, 0, rfd);
+      setupPipe(fromPlayer, 1, wfd);
+   }
+   if((pid = fork()) < 0) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   else if(pid == 0) {
+      signal(SIGPIPE, SIG_DFL);
+      if(shm ? fcntl(memFD, F_SETFD, 0) :
+         fcntl(toPlayer[0], F_SETFD, 0) || fcntl(fromPlayer[1], F_SETFD, 0))
+         _exit(EXIT_FAILURE);
+      execl(path, path, rfd, wfd, (char *)0);
+      perror(NULL);
+      _exit(EXIT_FAILURE);
+   }
+   if(shm) {
+      closeEnd(memFD);
+      connInitRing(&p->conn, &p->rings->fromPlayer, &p->rings->toPlayer, pid);
+   }
+   else {
+      closeEnd(toPlayer[0]);
+      closeEnd(fromPlayer[1]);
+      connInit(&p->conn, fromPlayer[0], toPlayer[1]);
+   }
+   connHello(&p->conn, start);
+   p->pid = pid;
+   p->plugin = NULL;
+}
+
+/* Returns the position of the ".so" suffix of a plugin player, or NULL when
+ * the argument names a program to execute.
+ */
+static char *pluginSuffix(char *arg) {
+   char *ext = strstr(arg, ".so");
+   while(ext != NULL && ext[3] != '\0' && ext[3] != ':')
+      ext = strstr(ext + 1, ".so");
+   return ext;
+}
+
+/* Load a plugin player and create its state. The path is made relative to
+ * the current directory when it has no '/' so dlopen doesn't search for it.
+ */
+static void setupPlugin(Player *p, char *arg, const MatchStart *start) {
+   char path[FILENAME_MAX], *ext = pluginSuffix(arg), *args = NULL;
+   void *handle;
+   if(ext[3] == ':')
+      args = ext + 4;
+   snprintf(path, sizeof(path), "%s%.*s", strchr(arg, '/') ? "" : "./",
+      (int)(ext + 3 - arg), arg);
+   if((handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)) == NULL) {
+      fprintf(stderr, "%s\n", dlerror());
+      exit(EXIT_FAILURE);
+   }
+   if((p->plugin = dlsym(handle, PLUGIN_SYMBOL)) == NULL) {
+      fprintf(stderr, "%s\n", dlerror());
+      exit(EXIT_FAILURE);
+   }
+   p->ctx = p->plugin->create(args);
+   if(p->plugin->onMatchStart)
+      p->plugin->onMatchStart(p->ctx, start);
+   connInit(&p->conn, -1, -1);
+   p->rings = NULL;
+   p->pid = -1;
+}
+
+void setupPlayer(Player *p, char *arg, int shm, const MatchStart *start) {
+   if(pluginSuffix(arg))
+      setupPlugin(p, arg, start);
+   else
+      setupProcess(p, arg, shm, start);
+   p->arg = arg;
+   p->shm = shm;
+   p->start = *start;
+   p->replay = NULL;
+   p->timing = NULL;
+   p->stats = NULL;
+   setupDeadlines(p, 0, 0);
+}
+
+void setupReplay(Player *p, const GameRecord *replay, int seat) {
+   connInit(&p->conn, -1, -1);
+   p->rings = NULL;
+   p->pid = -1;
+   p->arg = NULL;
+   p->plugin = NULL;
+   p->replay = replay;
+   p->seat = p->next = seat;
+   p->timing = NULL;
+   p->stats = NULL;
+   setupDeadlines(p, 0, 0);
+}
+
+/* Limits the time a player has for each answer and for all of them in the
+ * match, 0 meaning no limit.
+ */
+void setupDeadlines(Player *p, long long moveNs, long long matchNs) {
+   p->moveNs = moveNs;
+   p->matchNs = matchNs;
+   p->usedNs = 0;
+   p->failed = p->retired = 0;
+}
+
+/* Each seat gets its own seed so two copies of a player don't mirror each
+ * other.
+ */
+MatchStart seatStart(unsigned long long seed, int seat, int size) {
+   MatchStart start;
+   memset(&start, 0, sizeof(start));
+   seed += seat;
+   start.seed = rngNext(&seed);
+   start.size = size;
+   return start;
+}
+
+Score setupScore(void) {
+   Score temp;
+   temp.wins = temp.losses = temp.draws = temp.forfeits = 0;
+   temp.totalHits = temp.totalMisses = temp.totalSinks = temp.totalThinkNs = 0;
+   temp.hits = temp.misses = temp.sinks = temp.forfeited = 0;
+   temp.thinkNs = 0;
+   return temp;
+}
+
+/* Adds the totals of one score to another.
+ */
+void addScore(Score *total, const Score *s) {
+   total->wins += s->wins;
+   total->losses += s->losses;
+   total->draws += s->draws;
+   total->forfeits += s->forfeits;
+   total->totalHits += s->totalHits;
+   total->totalMisses += s->totalMisses;
+   total->totalSinks += s->totalSinks;
+   total->totalThinkNs += s->totalThinkNs;
+}
+
+/* Reads a count given to an option, which has to be a positive number, and
+ * calls usage, which exits, when it isn't.
+ */
+unsigned long long getCount(char *arg, void (*usage)(void)) {
+   char *end;
+   unsigned long long n = strtoull(arg, &end, 10);
+   if(*arg == '-' || *end != '\0' || n == 0)
+      usage();
+   return n;
+}
+
+/* Extract the names of the players from the arguments provided: the file
+ * name without its directory or plugin suffix, cut to fit.
+ */
+void getName(char (*name)[MAX_NAME], char *arg) {
+   char *base = strrchr(arg, '/'), *ext;
+   base = base != NULL ? base + 1 : arg;
+   ext = pluginSuffix(base);
+   snprintf(*name, MAX_NAME, "%.*s", ext != NULL ? (int)(ext - base) : (int)strlen(base), base);
+}
+
+/* Tells a player the name of the opponent it is about to play. A plugin's
+ * arguments follow its name, since the same plugin with other arguments is
+ * another opponent. Arguments too long to fit are given by a hash instead.
+ */
+void nameOpponent(MatchStart *start, char *arg) {
+   char *base = strrchr(arg, '/'), *args;
+   unsigned int h = 2166136261u;
+   size_t n;
+   getName(&start->opponent, arg);
+   args = pluginSuffix(base != NULL ? base + 1 : arg);
+   if(args == NULL || args[3] != ':')
+      return;
+   args += 3;
+   n = strlen(start->opponent);
+   if(n + strlen(args) < MAX_NAME) {
+      strcpy(start->opponent + n, args);
+      return;
+   }
+   for(; *args; args++)
+      h = (h ^ (unsigned char)*args) * 16777619u;
+   n = n < MAX_NAME - 10 ? n : MAX_NAME - 10;
+   snprintf(start->opponent + n, MAX_NAME - n, ":%08x", h);
+}
+
+/* When a player's answer is due, or 0 if it can take as long as it likes.
+ */
+static long long deadline(Player *p, long long now) {
+   long long limit = p->moveNs;
+   if(p->moveNs == 0 && p->matchNs == 0)
+      return 0;
+   if(p->matchNs && (limit == 0 || p->matchNs - p->usedNs < limit))
+      limit = p->matchNs - p->usedNs;
+   if(p->conn.framed == -1)
+      limit += STARTUP_NS;
+   return now + (limit > 0 ? limit : 0);
+}
+
+/* Times an answer and charges it to the player. A plugin can't be stopped
+ * while it thinks, so it only fails once it returns too late. Returns -1 if
+ * the player forfeits the game.
+ */
+static int answered(Player *p, Histogram *h, long long start) {
+   static const char *why[] = {"", "missed its deadline", "is gone", "sent a bad reply"};
+   long long end = start ? monotonicNs() : 0;
+   if(h)
+      histAdd(h, end - start);
+   p->usedNs += end - start;
+   if(p->conn.deadline && end > p->conn.deadline && !p->conn.failed)
+      p->conn.failed = CONN_TIMEOUT;
+   p->conn.deadline = 0;
+   if(p->conn.failed == 0)
+      return 0;
+   p->failed = 1;
+   p->retired = p->retired || (p->matchNs && p->usedNs >= p->matchNs);
+   fprintf(stderr, "%s %s and forfeits the game%s\n", p->arg, why[p->conn.failed],
+      p->retired ? " and the rest of the match" : "");
+   return -1;
+}
+
+/* The following functions hide whether a player is a plugin, a process or a
+ * replay. Messages to a process are queued and go out in one write when the
+ * host next waits for that player, so a turn costs one write and one read.
+ * A replayed player fails where the recorded one did.
+ *
+ * Asking for an answer and taking it are separate so a host can wait for many
+ * players at once. ask starts the clock on the answer and returns when it
+ * started, and a plugin is only called once its answer is taken.
+ */
+static long long ask(Player *p, int type) {
+   long long start = p->timing || p->moveNs || p->matchNs ? monotonicNs() : 0;
+   if(p->failed || p->replay)
+      return start;
+   p->conn.deadline = deadline(p, start);
+   if(!p->plugin)
+      connSend(&p->conn, type, NULL, 0);
+   return start;
+}
+
+/* Whether a player's answer of the given type can be taken without waiting:
+ * it has arrived, the player failed or its deadline passed.
+ */
+static int ready(Player *p, int type) {
+   if(p->failed || p->replay || p->plugin || connReady(&p->conn, type))
+      return 1;
+   if(p->conn.deadline && monotonicNs() >= p->conn.deadline)
+      p->conn.failed = CONN_TIMEOUT;
+   return p->conn.failed != 0;
+}
+
+/* A board has nothing allocated until it is set up on a large board.
+ */
+void initBoard(BoardState *b) {
+   b->large = NULL;
+   b->largeSize = 0;
+}
+
+void freeBoard(BoardState *b) {
+   free(b->large);
+   initBoard(b);
+}
+
+/* Empties a board for a game on a size x size board, allocating the cells of
+ * a large board unless it was last set up for the same size.
+ */
+static void clearBoard(BoardState *b, int size) {
+   b->size = size;
+   b->words = boardWords(size);
+   if(size * size <= MASK_CELLS) {
+      b->shipAt = b->smallAt;
+      b->hits = b->smallHits;
+   }
+   else {
+      if(b->largeSize != size) {
+         free(b->large);
+         if((b->large = malloc(b->words * sizeof(b->hits[0]) + size * size)) == NULL) {
+            perror(NULL);
+            exit(EXIT_FAILURE);
+         }
+         b->largeSize = size;
+      }
+      b->hits = b->large;
+      b->shipAt = (unsigned char *)(b->hits + b->words);
+   }
+   memset(b->hits, 0, b->words * sizeof(b->hits[0]));
+   memset(b->shipAt, 0, size * size);
+   memset(b->left, 0, NUMBER_OF_SHIPS);
+}
+
+static void addShipCell(BoardState *b, int ship, int cell) {
+   b->shipAt[cell] = ship + 1;
+   b->left[ship]++;
+}
+
+/* Build a board from the placements of its ships. Returns -1 if a ship
+ * doesn't fit on the board or overlaps another one.
+ */
+int setupBoard(BoardState *b, const Fleet *f, int size) {
+   const Placement *p;
+   int ship = 0, i, cell;
+   clearBoard(b, size);
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      p = &f->ships[ship];
+      if(p->down > 1 || p->row + (p->down ? fleetLength[ship] : 1) > size ||
+         p->col + (p->down ? 1 : fleetLength[ship]) > size)
+         return -1;
+      for(i = 0; i < fleetLength[ship]; i++) {
+         cell = p->row * size + p->col + (p->down ? i * size : i);
+         if(b->shipAt[cell])
+            return -1;
+         addShipCell(b, ship, cell);
+      }
+   }
+   return 0;
+}
+
+/* Build a board of the original protocol from its cells, which only fit a
+ * game on a SIZE x SIZE board. Its ships may have any number of cells.
+ */
+static int setupCells(BoardState *b, char cells[SIZE][SIZE], int size) {
+   int cell = 0, ship;
+   if(size != SIZE)
+      return -1;
+   clearBoard(b, size);
+   for(; cell < SIZE * SIZE; cell++) {
+      if((ship = cellShip(cells[cell / SIZE][cell % SIZE])) != -1)
+         addShipCell(b, ship, cell);
+   }
+   return 0;
+}
+
+/* Build a board from the cells of its ships.
+ */
+static void setupShips(BoardState *b, const Bitboard *ships, int size) {
+   unsigned long long bits;
+   int ship = 0, i;
+   clearBoard(b, size);
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      for(i = 0; i < b->words; i++) {
+         for(bits = ships[ship].words[i]; bits; bits &= bits - 1)
+            addShipCell(b, ship, i * 64 + __builtin_ctzll(bits));
+      }
+   }
+}
+
+/* Resolve a shot against a board of SIDE cells a side, whose ship index and
+ * hit mask are SHIP_AT and HITS. A ship sinks when the shot is a new hit on
+ * it that leaves none of its cells unhit. Shooting a hit cell again is a hit,
+ * and shooting off the board a miss. Instantiated for the standard board,
+ * where the side is a constant and the cells are at fixed places in the
+ * struct, and once for any size.
+ */
+#define RESOLVE_KERNEL(name, SIDE, SHIP_AT, HITS) \
+static int name(BoardState *b, Shot s) { \
+   int cell = s.row * (SIDE) + s.col, ship; \
+   if(s.row >= (SIDE) || s.col >= (SIDE) || (ship = (SHIP_AT)[cell]) == 0) \
+      return MISS; \
+   if((HITS)[cell >> 6] >> (cell & 63) & 1) \
+      return HIT; \
+   (HITS)[cell >> 6] |= 1ULL << (cell & 63); \
+   return --b->left[ship - 1] ? HIT : SINK; \
+}
+
+RESOLVE_KERNEL(resolve10, SIZE, b->smallAt, b->smallHits)
+RESOLVE_KERNEL(resolveAny, b->size, b->shipAt, b->hits)
+
+int resolveShot(BoardState *b, Shot s) {
+   return b->size == SIZE ? resolve10(b, s) : resolveAny(b, s);
+}
+
+/* Takes a player's board for a game on a size x size board. A board that
+ * doesn't fit is a bad reply. A player of the original protocol can't place
+ * ships on any other board than SIZE x SIZE, so it is retired rather than
+ * restarted for every game only to fail again.
+ */
+static int takeBoard(Player *p, BoardState *b, int size, long long start) {
+   BoardReply reply;
+   if(p->failed)
+      return -1;
+   if(p->replay) {
+      setupShips(b, p->replay->ships[p->seat], size);
+      p->next = p->seat;
+      return 0;
+   }
+   if(p->plugin)
+      p->plugin->newGame(p->ctx, &reply.fleet);
+   else
+      connExpect(&p->conn, BOARD, &reply, sizeof(Fleet));
+   if(!p->conn.failed && !p->plugin && p->conn.framed == 0 && size != SIZE) {
+      fprintf(stderr, "%s only plays on a %d x %d board\n", p->arg, SIZE, SIZE);
+      p->retired = 1;
+   }
+   if(!p->conn.failed && (p->plugin || p->conn.framed ? setupBoard(b, &reply.fleet, size) :
+      setupCells(b, reply.cells, size)))
+      p->conn.failed = CONN_INVALID;
+   return answered(p, p->timing ? &p->timing->board : NULL, start);
+}
+
+static int takeShot(Player *p, Shot *shot, long long start) {
+   if(p->replay) {
+      if(p->next < p->replay->shotCount) {
+         *shot = p->replay->shots[p->next];
+         p->next += 2;
+         return 0;
+      }
+      if(p->replay->forfeits[p->seat]) {
+         p->failed = 1;
+         return -1;
+      }
+      fprintf(stderr, "the recorded game ends before the replay does\n");
+      exit(EXIT_FAILURE);
+   }
+   if(p->plugin)
+      *shot = p->plugin->chooseShot(p->ctx);
+   else
+      connExpect(&p->conn, SHOT, shot, sizeof(Shot));
+   return answered(p, p->timing ? &p->timing->think : NULL, start);
+}
+
+static void sendResult(Player *p, int result) {
+   if(p->replay)
+      return;
+   if(p->plugin)
+      p->plugin->onResult(p->ctx, result);
+   else
+      connSend(&p->conn, SHOT_RESULT, &result, sizeof(int));
+}
+
+static void sendOppShot(Player *p, Shot shot) {
+   if(p->replay)
+      return;
+   if(p->plugin)
+      p->plugin->onOpponentShot(p->ctx, shot);
+   else
+      connSend(&p->conn, OPPONENTS_SHOT, &shot, sizeof(Shot));
+}
+
+/* Closes the connection to a process and waits for it to exit. A process
+ * that failed is killed, and one with a deadline gets as long to exit as it
+ * gets for an answer.
+ */
+static void stopProcess(Player *p) {
+   struct timespec ts = {0, EXIT_POLL_NS};
+   long long end = p->moveNs ? monotonicNs() + p->moveNs : 0;
+   if(p->rings)
+      ringRelease(p->rings);
+   else {
+      closeEnd(p->conn.rfd);
+      closeEnd(p->conn.wfd);
+   }
+   if(p->failed)
+      kill(p->pid, SIGKILL);
+   else if(end) {
+      while(waitpid(p->pid, NULL, WNOHANG) == 0) {
+         if(monotonicNs() >= end) {
+            kill(p->pid, SIGKILL);
+            break;
+         }
+         nanosleep(&ts, NULL);
+      }
+   }
+   waitpid(p->pid, NULL, 0);
+}
+
+/* Tells a player the match is over, then frees a plugin's state or waits for
+ * a process to exit.
+ */
+void endMatch(Player *p) {
+   if(p->replay)
+      return;
+   if(p->plugin)
+      p->plugin->destroy(p->ctx);
+   else {
+      connSend(&p->conn, MATCH_OVER, NULL, 0);
+      connFlush(&p->conn);
+      stopProcess(p);
+   }
+}
+
+/* Gets a player ready for the next game. A process that forfeited the last
+ * one is started again unless it is out of time, and a replayed player that
+ * forfeited before its first shot does so again.
+ */
+static void startGame(Player *p) {
+   if(p->replay) {
+      p->failed = p->replay->forfeits[p->seat] && p->replay->shotCount == 0;
+      return;
+   }
+   if(p->failed && !p->retired && !p->plugin) {
+      stopProcess(p);
+      setupProcess(p, p->arg, p->shm, &p->start);
+   }
+   if(p->plugin)
+      p->conn.failed = 0;
+   p->failed = p->retired;
+}
+
+/* Checks for a win based on the amount of sinks.
+ */
+static void checkWin(int (*wins)[2], Score *a, Score *b) {
+   (*wins)[0] = (*wins)[1] = 0;
+   if(a->sinks == 5 && b->sinks == 5) {   // draw when both players win on their last shot
+      a->draws++;
+      b->draws++;
+      (*wins)[0] = (*wins)[1] = 1;
+   }
+   else if(a->sinks == 5) {
+      a->wins++;
+      b->losses++;
+      (*wins)[0] = 1;
+   }
+   else if(b->sinks == 5) {
+      a->losses++;
+      b->wins++;
+      (*wins)[1] = 1;
+   }
+   else {      // both lose if no one sinks all the ships
+      a->losses++;
+      b->losses++;
+   }
+}
+
+/* A player that failed loses the game whatever the score, and the other one
+ * wins it unless it failed too.
+ */
+static void forfeitGame(int (*wins)[2], Player *a, Player *b, Score *sa, Score *sb) {
+   (*wins)[0] = !a->failed;
+   (*wins)[1] = !b->failed;
+   sa->wins += (*wins)[0];
+   sa->losses += !(*wins)[0];
+   sb->wins += (*wins)[1];
+   sb->losses += !(*wins)[1];
+   sa->forfeited = a->failed;
+   sb->forfeited = b->failed;
+   sa->forfeits += a->failed;
+   sb->forfeits += b->failed;
+}
+
+/* Adds the stats of the game that just ended to the totals and resets them.
+ */
+void endGame(Score *s) {
+   s->totalHits += s->hits;
+   s->totalMisses += s->misses;
+   s->totalSinks += s->sinks;
+   s->totalThinkNs += s->thinkNs;
+   s->hits = s->misses = s->sinks = s->forfeited = 0;
+   s->thinkNs = 0;
+}
+
+/* Determines the shot's results and increments the correct stats.
+ * Also writes the results and proper signals to players.
+ */
+static void processShot(Player *shooter, Player *opp, Score *score,
+   BoardState *board, GameRecord *record, Shot shot) {
+   int result;
+   if(record)
+      record->shots[record->shotCount++] = shot;
+   result = resolveShot(board, shot);
+   score->misses += (result == MISS);
+   score->hits += (result != MISS);
+   score->sinks += (result == SINK);
+   if(shooter->stats)
+      statsShot(shooter->stats, shot, result, score->hits + score->misses, score->hits,
+         score->sinks);
+   sendResult(shooter, result);
+   sendOppShot(opp, shot);
+}
+
+/* Fills in how the game ended once it is over.
+ */
+static void recordEnd(GameRecord *record, Score *a, Score *b, int (*wins)[2]) {
+   record->forfeits[0] = a->forfeited;
+   record->forfeits[1] = b->forfeited;
+   record->hits[0] = a->hits;
+   record->hits[1] = b->hits;
+   record->sinks[0] = a->sinks;
+   record->sinks[1] = b->sinks;
+   record->wins[0] = (*wins)[0];
+   record->wins[1] = (*wins)[1];
+}
+
+void gameStart(Game *g, Player *a, Player *b, Score *sa, Score *sb,
+   GameRecord *record, int simultaneous) {
+   g->players[0] = a;
+   g->players[1] = b;
+   g->scores[0] = sa;
+   g->scores[1] = sb;
+   g->record = record;
+   g->size = a->replay ? a->replay->size : a->start.size;
+   g->simultaneous = simultaneous;
+   g->round = g->asked = g->taken = g->waiting = 0;
+   if(record) {
+      record->size = g->size;
+      record->shotCount = 0;
+      memset(record->ships, 0, sizeof(record->ships));
+   }
+   initBoard(&g->states[0]);
+   initBoard(&g->states[1]);
+   startGame(a);
+   startGame(b);
+   g->used[0] = a->usedNs;
+   g->used[1] = b->usedNs;
+}
+
+/* Waits for whichever of two process players answers first, so neither is
+ * charged for the time the other takes. Only pipes can be waited on together,
+ * so otherwise the first player's answer is taken first.
+ */
+static int awaitEither(Game *g, int type) {
+   struct pollfd fds[2];
+   long long left, due = 0;
+   int seat = 0;
+   for(; seat < 2; seat++) {
+      if(g->players[seat]->failed || g->players[seat]->replay || g->players[seat]->plugin ||
+         g->players[seat]->rings || connFlush(&g->players[seat]->conn) ||
+         connBuffered(&g->players[seat]->conn, type))
+         return seat;
+      fds[seat].fd = g->players[seat]->conn.rfd;
+      fds[seat].events = POLLIN;
+      fds[seat].revents = 0;
+      if(g->players[seat]->conn.deadline && (due == 0 || g->players[seat]->conn.deadline < due))
+         due = g->players[seat]->conn.deadline;
+   }
+   left = due ? due - monotonicNs() : -1;
+   if(left > 0 || due == 0)
+      poll(fds, 2, due ? (left + 999999) / 1000000 : -1);
+   return fds[0].revents == 0 && fds[1].revents != 0;
+}
+
+/* Picks an asked player whose answer can be taken. With wait set that may
+ * mean waiting for it, otherwise it returns -1 if no answer is ready.
+ */
+static int pick(Game *g, int wait) {
+   int pending = g->asked & ~g->taken, type = g->round ? SHOT : BOARD;
+   if(wait)
+      return pending == 3 ? awaitEither(g, type) : pending == 2;
+   if(pending & 1 && ready(g->players[0], type))
+      return 0;
+   if(pending & 2 && ready(g->players[1], type))
+      return 1;
+   return -1;
+}
+
+static int take(Game *g, int seat) {
+   if(g->round == 0)
+      return takeBoard(g->players[seat], &g->states[seat], g->size, g->starts[seat]);
+   return takeShot(g->players[seat], &g->shots[seat], g->starts[seat]);
+}
+
+/* Keeps the ships of both boards in the record.
+ */
+static void recordBoards(Game *g) {
+   int seat = 0, cell, ship, cells = g->size * g->size;
+   for(; seat < 2; seat++) {
+      for(cell = 0; cell < cells; cell++) {
+         if((ship = g->states[seat].shipAt[cell]) != 0)
+            addCell(&g->record->ships[seat][ship - 1], cell);
+      }
+   }
+}
+
+/* Counts the ships of both boards for the players that keep stats.
+ */
+static void countBoards(Game *g) {
+   int seat = 0;
+   for(; seat < 2; seat++) {
+      if(g->players[seat]->stats)
+         statsBoard(g->players[seat]->stats, g->states[seat].shipAt);
+   }
+}
+
+static void shoot(Game *g, int seat) {
+   processShot(g->players[seat], g->players[!seat], g->scores[seat], &g->states[!seat],
+      g->record, g->shots[seat]);
+}
+
+/* Main game logic: sends out signals and reads in the responses.
+ * Takes answers until the game is over and returns 1, or with wait unset
+ * returns 0 as soon as the answers it needs haven't arrived yet. The result
+ * is then in both scores and wins, and everything that happened in record
+ * unless it is NULL.
+ *
+ * A player that fails ends the game. When both were asked the other answer
+ * is still taken so it can't be mistaken for the answer to a later request,
+ * and the first player's shot counts as it would have in turns.
+ */
+int gameStep(Game *g, int wait) {
+   Player *a = g->players[0], *b = g->players[1];
+   int seat;
+   while(1) {
+      for(seat = 0; seat < 2; seat++) {
+         if(g->asked >> seat & 1 || (seat == 1 && !g->simultaneous && g->taken == 0))
+            continue;
+         g->starts[seat] = ask(g->players[seat], g->round ? SHOT_REQUEST : NEW_GAME);
+         g->asked |= 1 << seat;
+      }
+      if((seat = pick(g, wait)) == -1) {
+         g->waiting = g->asked & ~g->taken;
+         return 0;
+      }
+      g->taken |= 1 << seat;
+      if(take(g, seat)) {
+         if(!g->simultaneous)
+            break;
+      }
+      else if(!g->simultaneous && g->round)
+         shoot(g, seat);
+      if(g->taken != 3)
+         continue;
+      if(g->simultaneous && g->round && !a->failed) {
+         shoot(g, 0);
+         if(!b->failed)
+            shoot(g, 1);
+      }
+      if(a->failed || b->failed)
+         break;
+      if(g->round == 0) {
+         if(g->record)
+            recordBoards(g);
+         countBoards(g);
+      }
+      else if(g->round == g->size * g->size || g->scores[0]->sinks == 5 ||
+         g->scores[1]->sinks == 5)
+         break;
+      g->round++;
+      g->asked = g->taken = 0;
+   }
+   g->waiting = 0;
+   freeBoard(&g->states[0]);
+   freeBoard(&g->states[1]);
+   g->scores[0]->thinkNs = a->usedNs - g->used[0];
+   g->scores[1]->thinkNs = b->usedNs - g->used[1];
+   if(a->failed || b->failed)
+      forfeitGame(&g->wins, a, b, g->scores[0], g->scores[1]);
+   else
+      checkWin(&g->wins, g->scores[0], g->scores[1]);
+   if(g->record)
+      recordEnd(g->record, g->scores[0], g->scores[1], &g->wins);
+   for(seat = 0; seat < 2; seat++) {
+      if(g->players[seat]->stats)
+         statsGame(g->players[seat]->stats, g->scores[seat]->hits + g->scores[seat]->misses,
+            g->scores[seat]->sinks);
+   }
+   return 1;
+}
+
+/* Plays one game and records its result in both scores, and everything that
+ * happened in record unless it is NULL.
+ */
+void playGame(Player *a, Player *b, Score *sa, Score *sb, int (*wins)[2],
+   GameRecord *record, int simultaneous) {
+   Game g;
+   gameStart(&g, a, b, sa, sb, record, simultaneous);
+   gameStep(&g, 1);
+   (*wins)[0] = g.wins[0];
+   (*wins)[1] = g.wins[1];
+}
@@ -0,0 +1,146 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <sys/types.h>
+#include "battleship.h"
+#include "bitboard.h"
+#include "placements.h"
+#include "plugin.h"
+#include "protocol.h"
+#include "histogram.h"
+#include "stats.h"
+
+/* Struct used to keep track of various stats. The hits, misses and sinks are
+ * for the current game and are added to the totals when it ends, as is
+ * thinkNs, the time the player took to answer once the game is over. A
+ * forfeited game counts as a loss and as one of forfeits, and sets forfeited
+ * until the game ends.
+ */
+typedef struct{
+   unsigned long long wins, losses, draws, forfeits;
+   unsigned long long totalHits, totalMisses, totalSinks;
+   unsigned long long totalThinkNs;
+   unsigned int hits, misses, sinks, forfeited;
+   long long thinkNs;
+} Score;
+
+/* Everything that happened in one game: the size of the board, the cells of
+ * each ship of both players, their shots in the order they were fired (the
+ * first player's at even indices), and how it ended. A player that forfeited
+ * stopped answering after the last of its shots, and its ships are empty if
+ * it never placed them.
+ */
+typedef struct{
+   int size;
+   Bitboard ships[2][NUMBER_OF_SHIPS];
+   Shot shots[2 * MAX_CELLS];
+   int shotCount;
+   unsigned int hits[2], sinks[2];
+   int wins[2], forfeits[2];
+} GameRecord;
+
+/* How long a player took to answer, from the request being queued to the
+ * answer being read, so the transport counts along with the thinking.
+ */
+typedef struct{
+   Histogram think;     /* SHOT_REQUEST to shot */
+   Histogram board;     /* NEW_GAME to board */
+} Timing;
+
+/* A player is either a separate process reached through a pair of pipes or
+ * shared memory rings, or a plugin loaded into the host and called directly.
+ * A replayed player gives the board and shots of its seat in replay instead.
+ * The answers of a player are timed when timing is set, and its shots and
+ * boards counted when stats is set.
+ *
+ * A player that misses its deadline, dies or answers nonsense forfeits the
+ * game. A process is then killed and started again from arg for the next
+ * game, unless it has used up its time for the match and forfeits every game
+ * left.
+ */
+typedef struct{
+   Conn conn;
+   RingPair *rings;
+   pid_t pid;
+   char *arg;
+   int shm;
+   MatchStart start;
+   const PlayerPlugin *plugin;
+   void *ctx;
+   const GameRecord *replay;
+   int seat, next;
+   Timing *timing;
+   Stats *stats;                 /* of the board size of the games */
+   long long moveNs, matchNs;    /* time allowed per answer and per match, 0 for no limit */
+   long long usedNs;             /* time taken by the answers so far */
+   int failed;                   /* forfeits the game being played */
+   int retired;                  /* out of time, forfeits the rest of the match */
+} Player;
+
+/* Struct holding one board during a game: the ship at each cell (its index
+ * + 1, 0 for open water), a mask of the cells that have been hit and how many
+ * cells of each ship are still unhit. A board of up to MASK_CELLS cells, the
+ * standard 10x10 among them, is kept in the struct itself, in under 200
+ * bytes. A larger one is kept in large, allocated for its size when it is set
+ * up and freed by freeBoard. shipAt and hits point at whichever is used, so a
+ * board isn't moved once it is set up.
+ */
+#define SMALL_WORDS (MASK_CELLS / 64)
+
+typedef struct{
+   unsigned char *shipAt;
+   unsigned long long *hits;
+   unsigned char left[NUMBER_OF_SHIPS];
+   int size, words;
+   unsigned long long smallHits[SMALL_WORDS];
+   unsigned char smallAt[MASK_CELLS];
+   void *large;
+   int largeSize;
+} BoardState;
+
+/* A game played one answer at a time, so one thread can keep many going.
+ * Round 0 asks for the boards and every round after it for a shot of each
+ * player. In turns the second player is asked once the first one's shot is
+ * known, and when simultaneous both are asked at once and their shots are
+ * resolved together, in the same order. asked and taken hold a bit for each
+ * seat, and waiting the seats a game that returned early waits for. The game
+ * is played on the board size its players were started with.
+ */
+typedef struct{
+   Player *players[2];
+   Score *scores[2];
+   GameRecord *record;
+   int size;
+   BoardState states[2];
+   Shot shots[2];
+   int simultaneous, round, asked, taken, waiting;
+   long long starts[2];       /* when each answer was asked for */
+   long long used[2];         /* time each player had taken before the game */
+   int wins[2];
+} Game;
+
+/* Players and games are independent of each other, so several matches can be
+ * played at once from different threads.
+ */
+unsigned long long getCount(char *arg, void (*usage)(void));
+void getName(char (*name)[MAX_NAME], char *arg);
+void initBoard(BoardState *b);
+int setupBoard(BoardState *b, const Fleet *f, int size);
+int resolveShot(BoardState *b, Shot s);
+void freeBoard(BoardState *b);
+void setupPlayer(Player *p, char *arg, int shm, const MatchStart *start);
+void setupReplay(Player *p, const GameRecord *replay, int seat);
+void setupDeadlines(Player *p, long long moveNs, long long matchNs);
+MatchStart seatStart(unsigned long long seed, int seat, int size);
+void nameOpponent(MatchStart *start, char *arg);
+void endMatch(Player *p);
+Score setupScore(void);
+void addScore(Score *total, const Score *s);
+void playGame(Player *a, Player *b, Score *sa, Score *sb, int (*wins)[2],
+   GameRecord *record, int simultaneous);
+void gameStart(Game *g, Player *a, Player *b, Score *sa, Score *sb,
+   GameRecord *record, int simultaneous);
+int gameStep(Game *g, int wait);
+void endGame(Score *s);
+
+#endif
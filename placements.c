@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "placements.h"
+
+static void *allocate(size_t size) {
+   void *p = malloc(size);
+   if(p == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   return p;
+}
+
+/* Lists the cells of every placement, then files each placement under the
+ * cells it covers. Even a 64x64 board takes only a few milliseconds.
+ */
+PlacementTable *placementsCreate(int size) {
+   PlacementTable *t = allocate(sizeof(PlacementTable));
+   int ship = 0, n = 0, i, j, cell, down, *at;
+   t->size = size;
+   t->cells = size * size;
+   for(t->count = 0; ship < NUMBER_OF_SHIPS; ship++)
+      t->count += 2 * acrossPlacements(size, fleetLength[ship]);
+   t->placementShip = allocate(t->count);
+   t->placementCells = allocate(t->count * sizeof(t->placementCells[0]));
+   t->placementMask = t->cells <= MASK_CELLS ?
+      allocate(t->count * sizeof(t->placementMask[0])) : NULL;
+   t->coverStart = allocate((t->cells + 1) * sizeof(int));
+   at = allocate(t->cells * sizeof(int));
+   for(ship = 0; ship < NUMBER_OF_SHIPS; ship++) {
+      t->shipPlacements[ship] = n;
+      for(i = 0; i < 2 * acrossPlacements(size, fleetLength[ship]); i++, n++) {
+         cell = placementStart(size, fleetLength[ship], i, &down);
+         t->placementShip[n] = ship;
+         for(j = 0; j < MAX_LENGTH; j++)
+            t->placementCells[n][j] = j < fleetLength[ship] ? cell + j * (down ? size : 1) : 0;
+         if(t->placementMask == NULL)
+            continue;
+         t->placementMask[n][0] = t->placementMask[n][1] = 0;
+         for(j = 0; j < fleetLength[ship]; j++)
+            t->placementMask[n][t->placementCells[n][j] >> 6] |=
+               1ULL << (t->placementCells[n][j] & 63);
+      }
+   }
+   t->shipPlacements[ship] = n;
+   for(cell = 0; cell <= t->cells; cell++)
+      t->coverStart[cell] = 0;
+   for(n = 0; n < t->count; n++) {
+      for(j = 0; j < fleetLength[t->placementShip[n]]; j++)
+         t->coverStart[t->placementCells[n][j] + 1]++;
+   }
+   for(cell = 0; cell < t->cells; cell++) {
+      t->coverStart[cell + 1] += t->coverStart[cell];
+      at[cell] = t->coverStart[cell];
+   }
+   t->cover = allocate(t->coverStart[t->cells] * sizeof(unsigned short));
+   for(n = 0; n < t->count; n++) {
+      for(j = 0; j < fleetLength[t->placementShip[n]]; j++)
+         t->cover[at[t->placementCells[n][j]]++] = n;
+   }
+   free(at);
+   return t;
+}
+
+void placementsFree(PlacementTable *t) {
+   free(t->placementShip);
+   free(t->placementCells);
+   free(t->placementMask);
+   free(t->coverStart);
+   free(t->cover);
+   free(t);
+}
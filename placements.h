@@ -0,0 +1,89 @@
+#ifndef PLACEMENTS_H
+#define PLACEMENTS_H
+
+#include "battleship.h"
+#include "bitboard.h"
+
+/* The longest ship, the cells the whole fleet takes, and the most placements
+ * there are on any board.
+ */
+#define MAX_LENGTH 5
+#define FLEET_CELLS 17
+#define MAX_PLACEMENTS (2 * MAX_SIZE * (NUMBER_OF_SHIPS * (MAX_SIZE + 1) - FLEET_CELLS))
+
+/* Boards of up to this many cells, 11x11 at most, also get a two-word mask
+ * of the cells of each placement.
+ */
+#define MASK_CELLS 128
+
+/* The length of each ship of the fleet, in the order of the ship values.
+ */
+static const unsigned char fleetLength[NUMBER_OF_SHIPS] = {
+   SIZE_AIRCRAFT_CARRIER, SIZE_BATTLESHIP, SIZE_DESTROYER, SIZE_SUBMARINE,
+   SIZE_PATROL_BOAT
+};
+
+/* The ship a cell of a board of the original protocol belongs to, or -1 for
+ * open water. The ship values are the multiples of AIRCRAFT_CARRIER in fleet
+ * order, and any other value counts as part of the patrol boat.
+ */
+static inline int cellShip(int value) {
+   int ship = value / AIRCRAFT_CARRIER - 1;
+   if(value == OPEN_WATER)
+      return -1;
+   if(value % AIRCRAFT_CARRIER || ship < 0 || ship >= NUMBER_OF_SHIPS)
+      return NUMBER_OF_SHIPS - 1;
+   return ship;
+}
+
+/* A ship of the given length has as many placements along the rows as down
+ * the columns.
+ */
+static inline int acrossPlacements(int size, int length) {
+   return size * (size - length + 1);
+}
+
+/* The placements of a ship are numbered along the rows first, row by row,
+ * then down the columns by the cell at their top. Returns the number of the
+ * placement starting at cell.
+ */
+static inline int placementNumber(int size, int length, int cell, int down) {
+   if(down)
+      return acrossPlacements(size, length) + cell;
+   return cell / size * (size - length + 1) + cell % size;
+}
+
+/* The cell a placement starts at and whether it runs down, or -1 when no
+ * placement of the ship has that number.
+ */
+static inline int placementStart(int size, int length, int n, int *down) {
+   int across = acrossPlacements(size, length);
+   *down = n >= across;
+   if(n < 0 || n >= 2 * across)
+      return -1;
+   if(*down)
+      return n - across;
+   return n / (size - length + 1) * size + n % (size - length + 1);
+}
+
+/* Every way to put each ship of the fleet on a board of one size, built when
+ * the size is known. Placements are grouped by ship in fleet order, from
+ * shipPlacements[ship] up to shipPlacements[ship + 1], in the order of their
+ * numbers. The placements covering a cell are cover[coverStart[cell]] up to
+ * cover[coverStart[cell + 1]], in increasing order. placementMask is NULL on
+ * boards of more than MASK_CELLS cells.
+ */
+typedef struct{
+   int size, cells, count;
+   int shipPlacements[NUMBER_OF_SHIPS + 1];
+   unsigned char *placementShip;
+   unsigned short (*placementCells)[MAX_LENGTH];
+   unsigned long long (*placementMask)[2];
+   int *coverStart;
+   unsigned short *cover;
+} PlacementTable;
+
+PlacementTable *placementsCreate(int size);
+void placementsFree(PlacementTable *t);
+
+#endif
@@ -2,9 +2,17 @@
 #define BATTLESHIP_H
 
 /* The Battleship board size. The board is a SIZExSIZE 2-dimensional char array.
+ * It is the size players of the original protocol play on and the one a match
+ * is played on unless the host picks another.
  */
 #define SIZE 10
 
+/* The largest board a match can be played on. The host tells players of the
+ * framed protocol the size of the board, from SIZE up to MAX_SIZE, in the
+ * MATCH_START message.
+ */
+#define MAX_SIZE 64
+
 /* The maximum number of shots it should take to sink every ship
  */
 #define MAX_SHOTS SIZE*SIZE
@@ -17,7 +25,7 @@
  */
 #define NUMBER_OF_SHIPS 5
 
-/* Number of games
+/* Default number of games in a match (battleship -g overrides it)
  */
 #define GAMES 2
 
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "density.h"
+#include "../rng.h"
+
+Density *densityCreate(void) {
+   Density *d = malloc(sizeof(Density));
+   if(d == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   memset(d->seen, 0, sizeof(d->seen));
+   d->pass = 0;
+   d->rng = 0;
+   d->table = placementsCreate(SIZE);
+   return d;
+}
+
+/* Seeds the engine for a match, and builds the placements again when the
+ * match is played on a board of another size.
+ */
+void densityStart(Density *d, unsigned long long seed, int size) {
+   d->rng = seed;
+   if(d->table->size != size) {
+      placementsFree(d->table);
+      d->table = placementsCreate(size);
+   }
+}
+
+void densityNewGame(Density *d) {
+   PlacementTable *t = d->table;
+   int cell = 0;
+   memset(d->cell, UNKNOWN, t->cells);
+   memset(d->alive, 1, t->count);
+   memset(d->open, 1, t->count);
+   for(; cell < t->cells; cell++)
+      d->density[cell] = t->coverStart[cell + 1] - t->coverStart[cell];
+   d->hits = 0;
+   d->unsunk[0] = d->unsunk[1] = 0;
+}
+
+void densityFree(Density *d) {
+   placementsFree(d->table);
+   free(d);
+}
+
+static void drop(Density *d, int n) {
+   PlacementTable *t = d->table;
+   int i = 0;
+   if(!d->alive[n])
+      return;
+   d->alive[n] = 0;
+   for(; i < fleetLength[t->placementShip[n]]; i++)
+      d->density[t->placementCells[n][i]]--;
+}
+
+/* The cells of a placement that are hits not yet put down to a ship, found
+ * from its cells on any board or from its mask on a small one.
+ */
+static int cellHits(Density *d, int n) {
+   PlacementTable *t = d->table;
+   int i = 0, hits = 0;
+   for(; i < fleetLength[t->placementShip[n]]; i++)
+      hits += d->cell[t->placementCells[n][i]] == HIT;
+   return hits;
+}
+
+static inline int maskHits(Density *d, int n) {
+   return __builtin_popcountll(d->table->placementMask[n][0] & d->unsunk[0]) +
+      __builtin_popcountll(d->table->placementMask[n][1] & d->unsunk[1]);
+}
+
+/* Close every placement covering a cell that can no longer hold a ship that
+ * is afloat.
+ */
+static void closeCell(Density *d, int cell) {
+   PlacementTable *t = d->table;
+   int k = t->coverStart[cell];
+   for(; k < t->coverStart[cell + 1]; k++)
+      d->open[t->cover[k]] = 0;
+}
+
+static void sinkCell(Density *d, int cell) {
+   d->cell[cell] = SUNK;
+   d->hits--;
+   if(cell < MASK_CELLS)
+      d->unsunk[cell >> 6] &= ~(1ULL << (cell & 63));
+   closeCell(d, cell);
+}
+
+/* The kernels that count the hits of placements, instantiated once with each
+ * way of counting them.
+ *
+ * sink puts a sink down to an open placement covering the cell, made only of
+ * hits not yet put down to another ship. The longest one is taken when
+ * several fit. Its cells become sunk and its ship's placements all go away.
+ *
+ * scoreTargets scores the unknown cells next to unsunk hits by the open
+ * placements through them, weighted by the square of how many of those hits
+ * each one explains. Every placement is counted once even if it covers
+ * several hits.
+ */
+#define DENSITY_KERNELS(suffix, hits) \
+static void sink##suffix(Density *d, int cell) { \
+   PlacementTable *t = d->table; \
+   int k = t->coverStart[cell], best = -1, n, i, ship; \
+   for(; k < t->coverStart[cell + 1]; k++) { \
+      n = t->cover[k]; \
+      ship = t->placementShip[n]; \
+      if(d->open[n] && hits(d, n) == fleetLength[ship] && (best == -1 || \
+         fleetLength[ship] > fleetLength[t->placementShip[best]])) \
+         best = n; \
+   } \
+   if(best == -1) {     /* no ship fits what was seen, forget the hit */ \
+      sinkCell(d, cell); \
+      return; \
+   } \
+   ship = t->placementShip[best]; \
+   for(i = 0; i < fleetLength[ship]; i++) \
+      sinkCell(d, t->placementCells[best][i]); \
+   for(n = t->shipPlacements[ship]; n < t->shipPlacements[ship + 1]; n++) { \
+      drop(d, n); \
+      d->open[n] = 0; \
+   } \
+} \
+\
+static void scoreTargets##suffix(Density *d, int *score) { \
+   PlacementTable *t = d->table; \
+   int cell = 0, k, n, i, h; \
+   d->pass++; \
+   for(; cell < t->cells; cell++) { \
+      if(d->cell[cell] != HIT) \
+         continue; \
+      for(k = t->coverStart[cell]; k < t->coverStart[cell + 1]; k++) { \
+         n = t->cover[k]; \
+         if(!d->open[n] || d->seen[n] == d->pass) \
+            continue; \
+         d->seen[n] = d->pass; \
+         h = hits(d, n); \
+         for(i = 0; i < fleetLength[t->placementShip[n]]; i++) { \
+            if(d->cell[t->placementCells[n][i]] == UNKNOWN) \
+               score[t->placementCells[n][i]] += h * h; \
+         } \
+      } \
+   } \
+}
+
+DENSITY_KERNELS(Cells, cellHits)
+DENSITY_KERNELS(Mask, maskHits)
+
+void densityRecord(Density *d, Shot shot, int result) {
+   PlacementTable *t = d->table;
+   int cell = shot.row * t->size + shot.col, k;
+   if(shot.row >= t->size || shot.col >= t->size || d->cell[cell] != UNKNOWN)
+      return;
+   for(k = t->coverStart[cell]; k < t->coverStart[cell + 1]; k++)
+      drop(d, t->cover[k]);
+   if(result == MISS) {
+      d->cell[cell] = MISS;
+      closeCell(d, cell);
+      return;
+   }
+   d->cell[cell] = HIT;
+   d->hits++;
+   if(cell < MASK_CELLS)
+      d->unsunk[cell >> 6] |= 1ULL << (cell & 63);
+   if(result == SINK && t->placementMask)
+      sinkMask(d, cell);
+   else if(result == SINK)
+      sinkCells(d, cell);
+}
+
+/* The unknown cell with the highest use, or any unknown cell when use is
+ * NULL. Every cell tied for the highest is equally likely to be picked.
+ * Returns -1 if there is none.
+ */
+static int bestCell(Density *d, const int *use) {
+   int cells = d->table->cells, cell = 0, best = -1, ties = 0;
+   for(; cell < cells; cell++) {
+      if(d->cell[cell] != UNKNOWN)
+         continue;
+      if(use != NULL && (use[cell] <= 0 || (best != -1 && use[cell] < use[best])))
+         continue;
+      if(best == -1 || (use != NULL && use[cell] > use[best]))
+         ties = 0;
+      if(rngBelow(&d->rng, ++ties) == 0)
+         best = cell;
+   }
+   return best;
+}
+
+/* Pick the unknown cell with the highest score, hunting by density when no
+ * hit is waiting to be sunk. A sink can be put down to the wrong one of two
+ * ships side by side, and once nothing fits what was seen any unknown cell
+ * is taken instead. Returns 0 only when every cell has been shot.
+ */
+int densityChoose(Density *d, Shot *out) {
+   int score[MAX_CELLS], best = -1;
+   if(d->hits != 0) {
+      memset(score, 0, d->table->cells * sizeof(score[0]));
+      if(d->table->placementMask)
+         scoreTargetsMask(d, score);
+      else
+         scoreTargetsCells(d, score);
+      best = bestCell(d, score);
+   }
+   if(best == -1)
+      best = bestCell(d, d->density);
+   if(best == -1)
+      best = bestCell(d, NULL);
+   if(best == -1)
+      return 0;
+   out->row = best / d->table->size;
+   out->col = best % d->table->size;
+   return 1;
+}
@@ -0,0 +1,43 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include "battleship.h"
+#include "../placements.h"
+
+/* What is known about a cell of the opponent's board. A sunk cell is a hit
+ * that has been put down to a ship that sank.
+ */
+#define UNKNOWN 0
+#define SUNK 4
+
+/* Targeting engine that fires where the most placements of the ships still
+ * afloat agree with what has been seen. The placements come from a table
+ * built for the size of the board, which densityStart sets for a match.
+ *
+ * A placement is alive while it covers no cell that has been shot, and open
+ * while it covers no miss and no sunk cell. density holds the number of alive
+ * placements covering each cell, and a result only touches the placements
+ * covering the cell that was shot, or those of the ship that sank. hits
+ * counts the cells that are hits not yet put down to a ship, and on a board
+ * of up to MASK_CELLS cells unsunk holds them as a mask. Ties between cells
+ * are broken at random from rng.
+ */
+typedef struct {
+   PlacementTable *table;
+   unsigned char alive[MAX_PLACEMENTS], open[MAX_PLACEMENTS];
+   unsigned char cell[MAX_CELLS];
+   int density[MAX_CELLS];
+   int hits;
+   unsigned long long unsunk[2];
+   int seen[MAX_PLACEMENTS], pass;
+   unsigned long long rng;
+} Density;
+
+Density *densityCreate(void);
+void densityStart(Density *d, unsigned long long seed, int size);
+void densityNewGame(Density *d);
+int densityChoose(Density *d, Shot *out);
+void densityRecord(Density *d, Shot shot, int result);
+void densityFree(Density *d);
+
+#endif
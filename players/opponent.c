@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "opponent.h"
+
+/* Games seen before the weights are trusted, and the games of a board that is
+ * shot at evenly the weights start from.
+ */
+#define MODEL_GAMES 2
+#define PRIOR_GAMES 2
+
+Opponent *opponentCreate(void) {
+   Opponent *o = malloc(sizeof(Opponent));
+   if(o == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   opponentStart(o, SIZE);
+   return o;
+}
+
+/* Forgets everything for a match against a new opponent.
+ */
+void opponentStart(Opponent *o, int size) {
+   o->size = size;
+   o->shots = 0;
+   o->firsts = 0;
+   clearCells(&o->seen, BOARD_WORDS);
+   memset(&o->own, 0, sizeof(o->own));
+   o->counts = &o->own;
+}
+
+/* Adds the games of the match to counts, which holds those of earlier
+ * matches against the same opponent on the same size of board, rather than
+ * to the player's own.
+ */
+void opponentKeep(Opponent *o, Targeting *counts) {
+   o->counts = counts;
+}
+
+/* Only the first shot at a cell in a game counts.
+ */
+void opponentShot(Opponent *o, Shot shot) {
+   int cell = shot.row * o->size + shot.col;
+   o->shots++;
+   if(shot.row >= o->size || shot.col >= o->size || hasCell(&o->seen, cell))
+      return;
+   addCell(&o->seen, cell);
+   o->firstCell[o->firsts] = cell;
+   o->firstShot[o->firsts++] = o->shots;
+}
+
+/* Ends the game the shots so far belong to, if the opponent fired any. The
+ * game is counted once its cells are, so a player that dies halfway leaves
+ * at worst a few cells counted for a game that isn't.
+ */
+void opponentNewGame(Opponent *o) {
+   Targeting *c = o->counts;
+   int i = 0;
+   if(o->shots == 0)
+      return;
+   for(; i < o->firsts; i++) {
+      __atomic_fetch_add(&c->fired[o->firstCell[i]], 1, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&c->order[o->firstCell[i]], o->firstShot[i], __ATOMIC_RELAXED);
+   }
+   __atomic_fetch_add(&c->length, o->shots + 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&c->games, 1, __ATOMIC_RELEASE);
+   o->shots = 0;
+   o->firsts = 0;
+   clearCells(&o->seen, boardWords(o->size));
+}
+
+/* The weight of a cell is the shot the opponent reaches it with on average,
+ * so a fleet weighs more the later the opponent can be expected to find it.
+ * The weights start out from PRIOR_GAMES games of shots in no order, which
+ * reach every cell half way through the board on average. Returns
+ * NULL, for fleets drawn uniformly, until MODEL_GAMES games are over.
+ */
+const double *opponentWeights(Opponent *o) {
+   const Targeting *c = o->counts;
+   unsigned long long games = __atomic_load_n(&c->games, __ATOMIC_ACQUIRE);
+   unsigned long long fired;
+   int cells = o->size * o->size, cell = 0;
+   double after;
+   if(games < MODEL_GAMES)
+      return NULL;
+   after = (double)c->length / games;
+   for(; cell < cells; cell++) {
+      fired = c->fired[cell] < games ? c->fired[cell] : games;    // ahead of games while shared
+      o->weights[cell] = (c->order[cell] + (games - fired) * after +
+         PRIOR_GAMES * (cells + 1) / 2.0) / (games + PRIOR_GAMES);
+   }
+   return o->weights;
+}
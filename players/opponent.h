@@ -0,0 +1,44 @@
+#ifndef OPPONENT_H
+#define OPPONENT_H
+
+#include "battleship.h"
+#include "../bitboard.h"
+
+/* Where an opponent shoots, over many games. fired counts the games in which
+ * the opponent fired at each cell and order adds up the shot it first did so
+ * with, counted from 1. A game in which the opponent never fired at a cell
+ * counts as reaching it one shot after the last, on average, which folds how
+ * seldom a cell is fired at into when it is reached.
+ */
+typedef struct{
+   unsigned long long games;
+   unsigned long long length;         /* the shots of each game + 1, added up */
+   unsigned int fired[MAX_CELLS];
+   unsigned long long order[MAX_CELLS];
+} Targeting;
+
+/* What a player has seen of where its opponent shoots. A shot costs a test
+ * and a store. When the game is over, its first shots at each cell are added
+ * to counts. counts points at own, which holds the games of this match, unless
+ * opponentKeep points it at Targeting kept elsewhere, such as a store's.
+ * Counts are added atomically, so they can be shared between players.
+ */
+typedef struct{
+   int size;
+   unsigned int shots;                /* of this game */
+   int firsts;
+   unsigned short firstCell[MAX_CELLS];
+   unsigned int firstShot[MAX_CELLS];
+   Bitboard seen;                     /* cells fired at this game */
+   Targeting own, *counts;
+   double weights[MAX_CELLS];
+} Opponent;
+
+Opponent *opponentCreate(void);
+void opponentStart(Opponent *o, int size);
+void opponentKeep(Opponent *o, Targeting *counts);
+void opponentShot(Opponent *o, Shot shot);
+void opponentNewGame(Opponent *o);
+const double *opponentWeights(Opponent *o);
+
+#endif
@@ -1,15 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
 #include "battleship.h"
+#include "../plugin.h"
+#include "../protocol.h"
+#include "../sampler.h"
 
-/* Structure used to keep track of the board and the last shot.
+/* Structure used to keep track of the board size and the last shot, and to
+ * draw the boards from.
  */
 typedef struct{
-   char board[SIZE][SIZE];
+   int size;
    char index[2];
+   FleetSampler *sampler;
 } Array;
 
+#ifndef PLUGIN
 static int getFD(const char *arg)
 {
    int fd;
@@ -20,124 +27,130 @@ static int getFD(const char *arg)
 
    return fd;
 }
-
-static int readMsg(int fd) {
-   int msg;
-   if(sizeof(int) != read(fd, &msg, sizeof(int))) {
-      fprintf(stderr, "read failure in %s at line %d\n", __FILE__, __LINE__);
-      exit(EXIT_FAILURE);
-   }
-   return msg;
-}
+#endif
 
 /* Initializes the Array structure.
  */
 static Array clear(Array arr) {
-   int i = 0, j;
-   for(; i < SIZE; i++) {
-      j = 0;
-      for(; j < SIZE; j++) 
-         arr.board[i][j] = 0;
-   }
    arr.index[0] = 0;
    arr.index[1] = 0;
    return arr;
 }
 
-static Array placeAC(Array arr) {
-   int i = 0;
-   for(; i < SIZE_AIRCRAFT_CARRIER; i++) 
-      arr.board[i][3] = AIRCRAFT_CARRIER;
-   return arr;
+/* Every fleet is as likely as any other, drawn from the seed of the match.
+ */
+static void startMatch(Array *arr, const MatchStart *start) {
+   arr->size = start->size;
+   samplerStart(arr->sampler, start->seed, start->size);
 }
 
-static Array placeB(Array arr) {
-   int i = 0;
-   for(; i < SIZE_BATTLESHIP; i++)
-      arr.board[i][2] = BATTLESHIP;
+/* Shoots in columns from left to right.
+ */
+static Array nextShot(Array arr, Shot *out) {
+   out->row = arr.index[0];
+   out->col = arr.index[1];
+   if(arr.index[0] < (arr.size - 1))
+      arr.index[0]++;
+   else {
+      arr.index[1]++;
+      arr.index[0] = 0;
+   }
    return arr;
 }
 
-static Array placeD(Array arr) {
-   int i = 0;
-   for(; i < SIZE_DESTROYER; i++)
-      arr.board[SIZE-1][i] = DESTROYER;   
+#ifdef PLUGIN
+static void *plugCreate(const char *args) {
+   Array *arr = malloc(sizeof(Array));
+   if(arr == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   arr->size = SIZE;
+   arr->sampler = samplerCreate();
    return arr;
 }
 
-static Array placeS(Array arr) {
-   int i = 0;
-   for(; i < SIZE_SUBMARINE; i++)
-      arr.board[6][i] = SUBMARINE;
-   return arr;
+static void plugOnMatchStart(void *player, const MatchStart *start) {
+   startMatch(player, start);
 }
 
-static Array placePB(Array arr) {
-   int i = 0;
-   for(; i < SIZE_PATROL_BOAT; i++)
-      arr.board[SIZE-1][i+6] = PATROL_BOAT;
-   return arr;
+static void plugNewGame(void *player, Fleet *fleet) {
+   *(Array *)player = clear(*(Array *)player);
+   samplerDraw(((Array *)player)->sampler, fleet);
 }
 
-static Array placeShips(Array arr) {
-   arr = placeAC(arr);
-   arr = placeB(arr);
-   arr = placeD(arr);
-   arr = placeS(arr);
-   arr = placePB(arr);
-   return arr;
+static Shot plugChooseShot(void *player) {
+   Shot out;
+   *(Array *)player = nextShot(*(Array *)player, &out);
+   return out;
 }
 
-static void sendBoard(int fd) {
-   Array out;
-   out = clear(out);
-   out = placeShips(out);
-   if(sizeof(out.board) != write(fd, out.board, sizeof(out.board))) {
-      fprintf(stderr, "write failure in %s at line %d\n", __FILE__, __LINE__);
-      exit(EXIT_FAILURE);
-   }
+static void plugOnResult(void *player, int result) {
 }
 
-/* Shoots in columns from left to right.
- */
-static Array sendShot(int fd, Array arr) {
+static void plugOnOpponentShot(void *player, Shot shot) {
+}
+
+static void plugDestroy(void *player) {
+   samplerFree(((Array *)player)->sampler);
+   free(player);
+}
+
+const PlayerPlugin battleshipPlayer = {
+   plugCreate, plugNewGame, plugChooseShot, plugOnResult,
+   plugOnOpponentShot, plugDestroy, plugOnMatchStart
+};
+#else
+static void sendBoard(Conn *c, FleetSampler *sampler) {
+   Fleet fleet;
+   samplerDraw(sampler, &fleet);
+   connSendBoard(c, &fleet);
+}
+
+static Array sendShot(Conn *c, Array arr) {
    Shot out;
-   out.row = arr.index[0];
-   out.col = arr.index[1];
-   if(sizeof(Shot) != write(fd, &out, sizeof(Shot))) {
-      fprintf(stderr, "write failure in %s at line %d\n", __FILE__, __LINE__);
-      exit(EXIT_FAILURE);
-   }
-   if(arr.index[0] < (SIZE - 1))
-      arr.index[0]++;
-   else {
-      arr.index[1]++;
-      arr.index[0] = 0;
-   }
+   arr = nextShot(arr, &out);
+   connSend(c, SHOT, &out, sizeof(Shot));
    return arr;
 }
 
 int main(int argc, char **argv) {
-   int readFD, writeFD, in = 0;
+   int readFD, writeFD, in = 0, msg[CONN_BUFFER / sizeof(int)];
    Array shots;
+   MatchStart start;
+   Conn conn;
+   RingPair *rings;
    if (argc != 3) {
       fprintf(stderr, "Usage: player readFD writeFD\n");
+      fprintf(stderr, "       player %s sharedMemoryFD\n", SHM_ARG);
       exit(EXIT_FAILURE);
    }
-   readFD = getFD(argv[1]);
-   writeFD = getFD(argv[2]);
+   if(strcmp(argv[1], SHM_ARG) == 0) {
+      rings = ringAttach(getFD(argv[2]));
+      connInitRing(&conn, &rings->toPlayer, &rings->fromPlayer, getppid());
+   }
+   else {
+      readFD = getFD(argv[1]);
+      writeFD = getFD(argv[2]);
+      connInit(&conn, readFD, writeFD);
+   }
+   shots.size = SIZE;
+   shots.sampler = samplerCreate();
    while(1) {
-      in = readMsg(readFD);
-      if(in == NEW_GAME) {
+      in = connRecv(&conn, msg, sizeof(msg));
+      if(in == MATCH_START) {
+         memcpy(&start, msg, sizeof(start));
+         startMatch(&shots, &start);
+      }
+      else if(in == NEW_GAME) {
          shots = clear(shots); 
-         sendBoard(writeFD);
+         sendBoard(&conn, shots.sampler);
       }
       else if(in == SHOT_REQUEST) 
-         shots = sendShot(writeFD, shots);
+         shots = sendShot(&conn, shots);
       else if(in == MATCH_OVER)
          break;
-      else
-         readMsg(readFD);
    }
    return EXIT_SUCCESS;
 }
+#endif
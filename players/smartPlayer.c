@@ -1,7 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <math.h>
 #include "battleship.h"
+#include "../plugin.h"
+#include "../protocol.h"
+#include "density.h"
+#include "opponent.h"
+#include "store.h"
+#include "../sampler.h"
+#include "../book.h"
+#include "../rng.h"
 
 #define UNSET -1
 
@@ -10,20 +20,38 @@
 #define DOWN 3
 #define LEFT 4
 
-#define BLOB_STYLE 6
-#define EDGE_STYLE 7
-#define PREMADE_STYLE 8
+#define CLASSIC_ARG "classic"
+#define BOOK_ENV "SMARTPLAYER_BOOK"
+#define OPENINGS_ENV "SMARTPLAYER_OPENINGS"
+#define STORE_ENV "SMARTPLAYER_STORE"
 
-
-/* Structure used in the logic of all the AI's decisions.
+/* Structure used in the logic of all the AI's decisions. Shots are aimed by
+ * the density engine unless it is NULL, in which case the classic zigzag and
+ * search are used, and the first shots come from the opening book when there
+ * is one for the size of the board. The ships are placed the way chooseStyle
+ * picks, so no two games are alike.
  */
 typedef struct{
-   char placeStyle;
-   char board[SIZE][SIZE];
+   char (*board)[MAX_SIZE];      /* rows kept elsewhere, only size of them used */
+   int size;
    int lastShot[2], lastHit[2], lastPShot[2];
-   int sunk, result, games, dir;
+   int sunk, result, dir;
+   Density *engine;              /* NULL for the classic shots */
+   FleetSampler *sampler;
+   Opponent *opponent;           /* where the opponent shoots */
+   Book *book;                   /* named by SMARTPLAYER_BOOK, or NULL */
+   Openings *openings;           /* named by SMARTPLAYER_OPENINGS, or NULL */
+   int opening;                  /* node of the opening book, -1 once out of it */
+   int turn;                     /* symmetry of the board the book is turned by */
+   unsigned long long bookRng;   /* draws the book's fleets and turns */
+   Store *store;                 /* named by SMARTPLAYER_STORE, or NULL */
+   OpponentRecord *record;       /* the store's on this opponent, or NULL */
+   int style;                    /* of this game's fleet, UNSET between games */
+   Bitboard *fleet;              /* cells of its own ships the opponent hasn't hit */
+   int fleetLeft;                /* how many there are */
 } PLogic;
 
+#ifndef PLUGIN
 static int getFD(const char *arg) {
    int fd;
    if (1 != sscanf(arg, "%d", &fd)) {
@@ -32,23 +60,15 @@ static int getFD(const char *arg) {
    }
    return fd;
 }
-
-static int readMsg(int fd) {
-   int msg;
-   if(sizeof(int) != read(fd, &msg, sizeof(int))) {
-      fprintf(stderr, "read failure in %s at line %d\n", __FILE__, __LINE__);
-      exit(EXIT_FAILURE);
-   }
-   return msg;
-}
+#endif
 
 /* Initialize the PLogic structure.
  */
 static PLogic clear(PLogic pl){
    int i = 0, j;
-   for(; i < SIZE; i++) {
+   for(; i < pl.size; i++) {
       j = 0;
-      for(; j < SIZE; j++)
+      for(; j < pl.size; j++)
          pl.board[i][j] = 0;
    }
    pl.lastShot[0] = pl.lastShot[1] = UNSET;
@@ -60,210 +80,14 @@ static PLogic clear(PLogic pl){
    return pl;
 }
 
-static PLogic placeAC(PLogic pl) {
-   int i = 0;
-   if(pl.placeStyle == BLOB_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_AIRCRAFT_CARRIER; i++)
-            pl.board[i+5][6] = AIRCRAFT_CARRIER;
-      }
-      else {
-         for(; i < SIZE_AIRCRAFT_CARRIER; i++)
-            pl.board[i+5][0] = AIRCRAFT_CARRIER;
-      }
-   }
-   else if(pl.placeStyle == EDGE_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_AIRCRAFT_CARRIER; i++)
-            pl.board[9][i+4] = AIRCRAFT_CARRIER;
-      }
-      else {
-         for(; i < SIZE_AIRCRAFT_CARRIER; i++)
-            pl.board[9][i] = AIRCRAFT_CARRIER;
-      }
-   }
-   else {
-      if(pl.games%2) {
-         for(; i < SIZE_AIRCRAFT_CARRIER; i++)
-            pl.board[i+5][2] = AIRCRAFT_CARRIER;
-      }
-      else {
-         for(; i < SIZE_AIRCRAFT_CARRIER; i++)
-            pl.board[0][i] = AIRCRAFT_CARRIER;
-      }
-   }
-   return pl;
-}
-
-static PLogic placeB(PLogic pl) {
-   int i = 0;
-   if(pl.placeStyle == BLOB_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_BATTLESHIP; i++)
-            pl.board[i+6][5] = BATTLESHIP;
-      }
-      else {
-         for(; i < SIZE_BATTLESHIP; i++)
-            pl.board[9][i+1] = BATTLESHIP;
-      }
-   }
-   else if(pl.placeStyle == EDGE_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_BATTLESHIP; i++)
-            pl.board[0][i+3] = BATTLESHIP;
-      }
-      else {
-         for(; i < SIZE_BATTLESHIP; i++)
-            pl.board[i+1][0] = BATTLESHIP;
-      }
-   }
-   else {
-      if(pl.games%2) {
-         for(; i < SIZE_BATTLESHIP; i++)
-            pl.board[i+6][7] = BATTLESHIP;
-      }
-      else {
-         for(; i < SIZE_BATTLESHIP; i++)
-            pl.board[i+2][5] = BATTLESHIP;
-      }
-   }
-   return pl;
+static int shot(Shot shot, const PLogic *pl) {
+   return pl->board[shot.row][shot.col];
 }
 
-static PLogic placeD(PLogic pl) {
-   int i = 0;
-   if(pl.placeStyle == BLOB_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_DESTROYER; i++)
-            pl.board[i+5][4] = DESTROYER;
-      }
-      else {
-         for(; i < SIZE_DESTROYER; i++)
-            pl.board[7][i+1] = DESTROYER;
-      }
-   }
-   else if(pl.placeStyle == EDGE_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_DESTROYER; i++)
-            pl.board[0][i+7] = DESTROYER;
-      }
-      else {
-         for(; i < SIZE_DESTROYER; i++)
-            pl.board[0][i+1] = DESTROYER;
-      }
-   }
-   else {
-      if(pl.games%2) {
-         for(; i < SIZE_DESTROYER; i++)
-            pl.board[i+4][6] = DESTROYER;
-      }
-      else {
-         for(; i < SIZE_DESTROYER; i++)
-            pl.board[i][9] = DESTROYER;
-      }
-   }
-   return pl;
-}
-
-static PLogic placeS(PLogic pl) {
-   int i = 0;
-   if(pl.placeStyle == BLOB_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_SUBMARINE; i++)
-            pl.board[i+3][5] = SUBMARINE;
-      }
-      else {
-         for(; i < SIZE_SUBMARINE; i++)
-            pl.board[8][i+1] = SUBMARINE;
-      }
-   }
-   else if(pl.placeStyle == EDGE_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_SUBMARINE; i++)
-            pl.board[i+5][0] = SUBMARINE;
-      }
-      else {
-         for(; i < SIZE_SUBMARINE; i++)
-            pl.board[0][i+5] = SUBMARINE;
-      }
-   }
-   else {
-      if(pl.games%2) {
-         for(; i < SIZE_SUBMARINE; i++)
-            pl.board[i+1][9] = SUBMARINE;
-      }
-      else {
-         for(; i < SIZE_SUBMARINE; i++)
-            pl.board[4][i+7] = SUBMARINE;
-      }
-   }
-   return pl;
-}
-
-static PLogic placePB(PLogic pl) {
-   int i = 0;
-   if(pl.placeStyle == BLOB_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_PATROL_BOAT; i++)
-            pl.board[i+8][4] = PATROL_BOAT;
-      }
-      else {
-         for(; i < SIZE_PATROL_BOAT; i++)
-            pl.board[6][i+1] = PATROL_BOAT;
-      }
-   }
-   else if(pl.placeStyle == EDGE_STYLE) {
-      if(pl.games%2) {
-         for(; i < SIZE_PATROL_BOAT; i++)
-            pl.board[i+1][0] = PATROL_BOAT;
-      }
-      else {
-         for(; i < SIZE_PATROL_BOAT; i++)
-            pl.board[9][i+2] = PATROL_BOAT;
-      }
-   }
-   else {
-      if(pl.games%2) {
-         for(; i < SIZE_PATROL_BOAT; i++)
-            pl.board[3][i+1] = PATROL_BOAT;
-      }
-      else {
-         for(; i < SIZE_PATROL_BOAT; i++)
-            pl.board[i+6][3] = PATROL_BOAT;
-      }
-   }
-   return pl;
-}
-
-static PLogic placeShips(PLogic pl) {
-   pl = placeAC(pl);
-   pl = placeB(pl);
-   pl = placeD(pl);
-   pl = placeS(pl);
-   pl = placePB(pl);
-   return pl;
-}
-
-static void sendBoard(int fd, PLogic pl) {
-   PLogic out;
-   out = clear(out);
-   out.games = pl.games;
-   out.placeStyle = pl.placeStyle;
-   out = placeShips(out);
-   if(sizeof(out.board) != write(fd, out.board, sizeof(out.board))) {
-      fprintf(stderr, "write failure in %s at line %d\n", __FILE__, __LINE__);
-      exit(EXIT_FAILURE);
-   }
-}
-
-static int shot(Shot shot, PLogic pl) {
-   return pl.board[shot.row][shot.col];
-}
-
-static int outOfBounds(Shot shot) {
-   if(shot.row >= SIZE || shot.row < 0)
+static int outOfBounds(Shot shot, int size) {
+   if(shot.row >= size || shot.row < 0)
       return 1;
-   if(shot.col >= SIZE || shot.col < 0)
+   if(shot.col >= size || shot.col < 0)
       return 1;
    return 0;
 }
@@ -282,70 +106,46 @@ static PLogic changeDir(PLogic pl) {
    return pl;
 }
 
-static PLogic sendShot(int fd, Shot shot, PLogic pl) {
-   if(sizeof(Shot) != write(fd, &shot, sizeof(Shot))) {
-      fprintf(stderr, "write failure in %s at line %d\n", __FILE__, __LINE__);
-      exit(EXIT_FAILURE);
-   }
+/* Records the shot that will be fired next.
+ */
+static PLogic aimShot(Shot shot, PLogic pl) {
    pl.lastShot[0] = shot.row;
    pl.lastShot[1] = shot.col;
    return pl;
 }
 
-/* Sends a shot that is searching for a ship after a hit.
+/* Fires at the first cell not shot yet. The zigzag only runs out of cells
+ * when a ship next to one that sank was hit and then forgotten.
  */
-static PLogic sendSearch(int fd, PLogic pl) {
+static PLogic sendSweep(PLogic pl) {
    Shot out;
-   int dx, dy;
-   dx = dy = 0;
-   out.row = pl.lastHit[0];
-   out.col = pl.lastHit[1];
-   while(1) {
-      if(pl.dir == UP) 
-         dy = -1;
-      else if(pl.dir == RIGHT)
-         dx = 1;
-      else if(pl.dir == DOWN)
-         dy = 1;
-      else
-         dx = -1;
-      out.row += dy;
-      out.col += dx;
-      if(outOfBounds(out)) {
-         pl = changeDir(pl);
-         dx = dy = 0;
-         out.row = pl.lastHit[0];
-         out.col = pl.lastHit[1];
-      }
-      else if(!shot(out, pl)) {
-         pl = sendShot(fd, out, pl);
-         break;
-      }
-      else if(shot(out, pl) != HIT) {
-         pl = changeDir(pl);
-         dx = dy = 0;
-         out.row = pl.lastHit[0];
-         out.col = pl.lastHit[1];
+   for(out.row = 0; out.row < pl.size; out.row++) {
+      for(out.col = 0; out.col < pl.size; out.col++) {
+         if(!shot(out, &pl))
+            return aimShot(out, pl);
       }
    }
-   return pl;
+   out.row = out.col = 0;
+   return aimShot(out, pl);
 }
 
 /* Sends a normal patterned shot that zigzags from the top right corner.
  */
-static PLogic sendStandard(int fd, PLogic pl) {
+static PLogic sendStandard(PLogic pl) {
    Shot out;
    if(pl.lastPShot[0] == UNSET && pl.lastPShot[1] == UNSET) {
       out.row = 0;
-      out.col = SIZE - 2;
+      out.col = pl.size - 2;
    }
    else {
       out.row = pl.lastPShot[0];
       out.col = pl.lastPShot[1];
    }
    while(1) {
-      if(!shot(out, pl)) {
-         pl = sendShot(fd, out, pl);
+      if(out.row >= pl.size)
+         return sendSweep(pl);
+      if(!shot(out, &pl)) {
+         pl = aimShot(out, pl);
          pl.lastPShot[0] = out.row;    // keeps track of last patterned shot to resume
          pl.lastPShot[1] = out.col;    // after sinking a ship with search
          break;
@@ -353,25 +153,128 @@ static PLogic sendStandard(int fd, PLogic pl) {
       if(out.col > 1)
          out.col -= 2;
       else {
-         out.col = SIZE - (out.row % 2) - 1;
+         out.col = pl.size - (out.row % 2) - 1;
          out.row++;
       }
    }
    return pl;
 }
 
-static PLogic selectShot(int fd, PLogic pl) {
-   if(pl.lastHit[0] != UNSET && pl.lastHit[0] != UNSET)
-      pl = sendSearch(fd, pl);
+/* Sends a shot that is searching for a ship after a hit, walking out from
+ * the hit one direction at a time. Instantiated for the standard board, where
+ * the bounds are constants, and once for any size. The zigzag takes over from
+ * a hit with every direction blocked, which happens when it was put down to
+ * the wrong one of two ships side by side.
+ */
+#define SEARCH_KERNEL(name, SIDE) \
+static PLogic name(PLogic pl) { \
+   Shot out; \
+   int dx, dy; \
+   dx = dy = 0; \
+   out.row = pl.lastHit[0]; \
+   out.col = pl.lastHit[1]; \
+   while(1) { \
+      if(pl.dir == UNSET) { \
+         pl.lastHit[0] = pl.lastHit[1] = UNSET; \
+         return sendStandard(pl); \
+      } \
+      if(pl.dir == UP) \
+         dy = -1; \
+      else if(pl.dir == RIGHT) \
+         dx = 1; \
+      else if(pl.dir == DOWN) \
+         dy = 1; \
+      else \
+         dx = -1; \
+      out.row += dy; \
+      out.col += dx; \
+      if(outOfBounds(out, (SIDE))) { \
+         pl = changeDir(pl); \
+         dx = dy = 0; \
+         out.row = pl.lastHit[0]; \
+         out.col = pl.lastHit[1]; \
+      } \
+      else if(!shot(out, &pl)) { \
+         pl = aimShot(out, pl); \
+         break; \
+      } \
+      else if(shot(out, &pl) != HIT) { \
+         pl = changeDir(pl); \
+         dx = dy = 0; \
+         out.row = pl.lastHit[0]; \
+         out.col = pl.lastHit[1]; \
+      } \
+   } \
+   return pl; \
+}
+
+SEARCH_KERNEL(search10, SIZE)
+SEARCH_KERNEL(searchAny, pl.size)
+
+static PLogic sendSearch(PLogic pl) {
+   return pl.size == SIZE ? search10(pl) : searchAny(pl);
+}
+
+/* The shot the opening book gives for the results so far, turned by the
+ * symmetry drawn for the game. Returns 0 once the game has left the book.
+ */
+static int openingShot(PLogic *pl, Shot *out) {
+   int cell, row, col, swap;
+   if(pl->opening < 0)
+      return 0;
+   if((cell = pl->openings->cells[pl->opening]) == NO_OPENING) {
+      pl->opening = -1;
+      return 0;
+   }
+   row = cell / pl->size;
+   col = cell % pl->size;
+   if(pl->turn & 1) {
+      swap = row;
+      row = col;
+      col = swap;
+   }
+   if(pl->turn & 2)
+      row = pl->size - 1 - row;
+   if(pl->turn & 4)
+      col = pl->size - 1 - col;
+   out->row = row;
+   out->col = col;
+   return 1;
+}
+
+/* The engine has a shot as long as any cell is unknown, so the classic shots
+ * are only fired without it.
+ */
+static PLogic selectShot(PLogic pl, Shot *out) {
+   if(openingShot(&pl, out))
+      pl = aimShot(*out, pl);
+   else if(pl.engine != NULL && densityChoose(pl.engine, out))
+      pl = aimShot(*out, pl);
+   else if(pl.lastHit[0] != UNSET && pl.lastHit[0] != UNSET)
+      pl = sendSearch(pl);
    else
-      pl = sendStandard(fd, pl);
+      pl = sendStandard(pl);
+   out->row = pl.lastShot[0];
+   out->col = pl.lastShot[1];
    return pl;
 }
 
 /* Store the shot's results to be used in determining future decisions. 
  */
-static PLogic storeResult(int fd, PLogic pl) {
-   pl.result = readMsg(fd);
+static PLogic storeResult(int result, PLogic pl) {
+   unsigned int next = 3 * pl.opening + result;
+   Shot last;
+   if(pl.engine != NULL) {
+      last.row = pl.lastShot[0];
+      last.col = pl.lastShot[1];
+      densityRecord(pl.engine, last, result);
+   }
+   if(pl.opening >= 0)
+      pl.opening = result >= MISS && result <= SINK && next < pl.openings->header.count ?
+         next : -1;
+   if(pl.record != NULL && (result == HIT || result == SINK))
+      storeFound(pl.record, pl.lastShot[0] * pl.size + pl.lastShot[1]);
+   pl.result = result;
    pl.board[(int)pl.lastShot[0]][(int)pl.lastShot[1]] = pl.result;
    if(pl.result == SINK) {
       pl.sunk++;
@@ -391,47 +294,276 @@ static PLogic storeResult(int fd, PLogic pl) {
    return pl;
 }
 
-/* Change styles on each loss. 
+/* Counts the game that is over, if there is one, for the opponent it was
+ * played against. It was won if the opponent's fleet sank and this one
+ * didn't, and a draw if both sank. A game in which neither sank ended
+ * without a result, by a forfeit, and isn't counted.
  */
-static PLogic setStyle(PLogic pl) {
-   if(pl.games == 0) 
-      pl.placeStyle = BLOB_STYLE;      // places ships together
-   else if(pl.placeStyle == BLOB_STYLE)
-      pl.placeStyle = EDGE_STYLE;      // places ships on the edge
-   else if(pl.placeStyle == EDGE_STYLE)
-      pl.placeStyle = PREMADE_STYLE;   // places ships based on a preset with no pattern
-   else
-      pl.placeStyle = PREMADE_STYLE;
+static void endGame(PLogic *pl) {
+   opponentNewGame(pl->opponent);
+   if(pl->record != NULL && pl->style != UNSET &&
+      (pl->sunk == NUMBER_OF_SHIPS || pl->fleetLeft == 0))
+      storeGame(pl->record, pl->style,
+                pl->sunk == NUMBER_OF_SHIPS && pl->fleetLeft > 0);
+   pl->style = UNSET;
+}
+
+/* Keeps the cells of the fleet the player placed, to tell when it sank.
+ */
+static void keepFleet(PLogic *pl, const Fleet *fleet) {
+   const Placement *p;
+   int ship = 0, i, cell, step;
+   clearCells(pl->fleet, boardWords(pl->size));
+   pl->fleetLeft = 0;
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      p = &fleet->ships[ship];
+      cell = p->row * pl->size + p->col;
+      step = p->down ? pl->size : 1;
+      for(i = 0; i < fleetLength[ship]; i++, cell += step, pl->fleetLeft++)
+         addCell(pl->fleet, cell);
+   }
+}
+
+/* Counts an opponent's shot, and any hit on the player's own fleet.
+ */
+static void opponentFired(PLogic *pl, Shot shot) {
+   int cell = shot.row * pl->size + shot.col;
+   opponentShot(pl->opponent, shot);
+   if(shot.row < pl->size && shot.col < pl->size && hasCell(pl->fleet, cell)) {
+      removeCell(pl->fleet, cell);
+      pl->fleetLeft--;
+   }
+}
+
+/* Resets the game state for the next game.
+ */
+static PLogic newGame(PLogic pl) {
+   endGame(&pl);
+   pl = clear(pl);
+   if(pl.engine != NULL)
+      densityNewGame(pl.engine);
+   pl.opening = -1;
+   if(pl.engine != NULL && pl.openings != NULL && pl.openings->header.size == pl.size) {
+      pl.opening = 0;
+      pl.turn = rngBelow(&pl.bookRng, 8);
+   }
+   return pl;
+}
+
+/* Sets up the engine and the sampler for a match. The sampler and the book
+ * take their seeds from the numbers after the match's, so the ships and the
+ * shots don't draw from the same numbers. Against an opponent the store
+ * knows, the opponent's shots are added to what is known of it already.
+ */
+static void startMatch(PLogic *pl, const MatchStart *start) {
+   unsigned long long seed = start->seed;
+   endGame(pl);
+   pl->size = start->size;
+   if(pl->engine != NULL)
+      densityStart(pl->engine, start->seed, start->size);
+   samplerStart(pl->sampler, rngNext(&seed), start->size);
+   opponentStart(pl->opponent, start->size);
+   pl->bookRng = rngNext(&seed);
+   pl->record = NULL;
+   if(pl->store != NULL && start->opponent[0] != '\0' &&
+      (pl->record = storeFind(pl->store, start->opponent, start->size)) != NULL)
+      opponentKeep(pl->opponent, &pl->record->targeting);
+}
+
+static void openFiles(PLogic *pl) {
+   char *path = getenv(BOOK_ENV);
+   pl->book = path != NULL ? bookOpen(path) : NULL;
+   path = getenv(OPENINGS_ENV);
+   pl->openings = path != NULL ? openingsOpen(path) : NULL;
+   path = getenv(STORE_ENV);
+   pl->store = path != NULL ? storeOpen(path) : NULL;
+   pl->record = NULL;
+   pl->opening = -1;
+   pl->style = UNSET;
+   pl->bookRng = 0;
+}
+
+/* Without a record of the opponent the ships are placed the best informed
+ * way the player can. With one, each way is tried once and from then on the
+ * way is chosen by UCB1 on how often each has won against the opponent.
+ */
+static int chooseStyle(const PLogic *pl, const int *usable) {
+   unsigned long long games[STYLES], total = 0;
+   double score, best = -1;
+   int style = STYLES - 1, choice = STYLE_UNIFORM;
+   if(pl->record == NULL) {
+      while(!usable[style])
+         style--;
+      return style;
+   }
+   for(; style >= 0; style--)
+      total += games[style] = __atomic_load_n(&pl->record->games[style], __ATOMIC_RELAXED);
+   for(style = STYLES - 1; style >= 0; style--) {
+      if(!usable[style])
+         continue;
+      if(games[style] == 0)
+         return style;
+      score = (double)__atomic_load_n(&pl->record->wins[style], __ATOMIC_RELAXED) /
+         games[style] + sqrt(2 * log(total) / games[style]);
+      if(score > best) {
+         best = score;
+         choice = style;
+      }
+   }
+   return choice;
+}
+
+/* Draws a fleet of the placement book when it was made for the size of the
+ * board, one that goes more often where the opponent shoots late once
+ * opponent has seen a few games of it, or any fleet, as chooseStyle picks.
+ */
+static void placeFleet(PLogic *pl, Fleet *fleet) {
+   const double *weights = opponentWeights(pl->opponent);
+   int usable[STYLES];
+   usable[STYLE_UNIFORM] = 1;
+   usable[STYLE_ADAPTED] = weights != NULL;
+   usable[STYLE_BOOK] = pl->book != NULL && pl->book->header.size == pl->size;
+   pl->style = chooseStyle(pl, usable);
+   if(pl->style == STYLE_BOOK)
+      *fleet = pl->book->fleets[rngBelow(&pl->bookRng, pl->book->header.count)];
+   else {
+      samplerWeigh(pl->sampler, pl->style == STYLE_ADAPTED ? weights : NULL);
+      samplerDraw(pl->sampler, fleet);
+   }
+   keepFleet(pl, fleet);
+}
+
+#ifdef PLUGIN
+static void *plugCreate(const char *args) {
+   PLogic *pl = malloc(sizeof(PLogic));
+   if(pl == NULL || (pl->board = malloc(MAX_SIZE * sizeof(pl->board[0]))) == NULL ||
+      (pl->fleet = malloc(sizeof(Bitboard))) == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   pl->sunk = 0;
+   pl->size = SIZE;
+   pl->engine = args != NULL && strcmp(args, CLASSIC_ARG) == 0 ? NULL : densityCreate();
+   pl->sampler = samplerCreate();
+   pl->opponent = opponentCreate();
+   openFiles(pl);
+   return pl;
+}
+
+static void plugNewGame(void *player, Fleet *fleet) {
+   PLogic *pl = player;
+   *pl = newGame(*pl);
+   placeFleet(pl, fleet);
+}
+
+static Shot plugChooseShot(void *player) {
+   Shot out;
+   *(PLogic *)player = selectShot(*(PLogic *)player, &out);
+   return out;
+}
+
+static void plugOnResult(void *player, int result) {
+   *(PLogic *)player = storeResult(result, *(PLogic *)player);
+}
+
+static void plugOnOpponentShot(void *player, Shot shot) {
+   opponentFired(player, shot);
+}
+
+static void plugDestroy(void *player) {
+   PLogic *pl = player;
+   endGame(pl);
+   if(pl->engine != NULL)
+      densityFree(pl->engine);
+   samplerFree(pl->sampler);
+   free(pl->opponent);
+   if(pl->book != NULL)
+      bookClose(pl->book);
+   if(pl->openings != NULL)
+      openingsClose(pl->openings);
+   if(pl->store != NULL)
+      storeClose(pl->store);
+   free(pl->board);
+   free(pl->fleet);
+   free(player);
+}
+
+static void plugOnMatchStart(void *player, const MatchStart *start) {
+   startMatch(player, start);
+}
+
+const PlayerPlugin battleshipPlayer = {
+   plugCreate, plugNewGame, plugChooseShot, plugOnResult,
+   plugOnOpponentShot, plugDestroy, plugOnMatchStart
+};
+#else
+static void sendBoard(Conn *c, PLogic *pl) {
+   Fleet fleet;
+   placeFleet(pl, &fleet);
+   connSendBoard(c, &fleet);
+}
+
+static PLogic sendShot(Conn *c, PLogic pl) {
+   Shot out;
+   pl = selectShot(pl, &out);
+   connSend(c, SHOT, &out, sizeof(Shot));
    return pl;
 }
 
 int main(int argc, char **argv) {
-   int readFD, writeFD, in = 0;
+   int readFD, writeFD, in = 0, msg[CONN_BUFFER / sizeof(int)];
+   char board[MAX_SIZE][MAX_SIZE];
+   Bitboard fleet;
    PLogic pl;
-   pl.sunk = pl.games = 0;
+   Conn conn;
+   RingPair *rings;
+   MatchStart start;
+   Shot opp;
+   pl.sunk = 0;
+   pl.board = board;
+   pl.fleet = &fleet;
+   pl.size = SIZE;
+   pl.engine = densityCreate();
+   pl.sampler = samplerCreate();
+   pl.opponent = opponentCreate();
+   openFiles(&pl);
    if (argc != 3) {
       fprintf(stderr, "Usage: player readFD writeFD\n");
+      fprintf(stderr, "       player %s sharedMemoryFD\n", SHM_ARG);
       exit(EXIT_FAILURE);
    }
-   readFD = getFD(argv[1]);
-   writeFD = getFD(argv[2]);
+   if(strcmp(argv[1], SHM_ARG) == 0) {
+      rings = ringAttach(getFD(argv[2]));
+      connInitRing(&conn, &rings->toPlayer, &rings->fromPlayer, getppid());
+   }
+   else {
+      readFD = getFD(argv[1]);
+      writeFD = getFD(argv[2]);
+      connInit(&conn, readFD, writeFD);
+   }
    while(1) {
-      in = readMsg(readFD);
+      in = connRecv(&conn, msg, sizeof(msg));
       if(in == NEW_GAME) {
-         if(pl.sunk != NUMBER_OF_SHIPS)
-            pl = setStyle(pl);
-         pl = clear(pl);
-         pl.games++;
-         sendBoard(writeFD, pl);
+         pl = newGame(pl);
+         sendBoard(&conn, &pl);
       }
       else if(in == SHOT_REQUEST)
-         pl = selectShot(writeFD, pl);
+         pl = sendShot(&conn, pl);
       else if(in == SHOT_RESULT)
-         pl = storeResult(readFD, pl);
-      else if(in == OPPONENTS_SHOT)
-         readMsg(readFD);
-      else if(in == MATCH_OVER)
+         pl = storeResult(msg[0], pl);
+      else if(in == OPPONENTS_SHOT) {
+         memcpy(&opp, msg, sizeof(opp));
+         opponentFired(&pl, opp);
+      }
+      else if(in == MATCH_START) {
+         memcpy(&start, msg, sizeof(start));
+         startMatch(&pl, &start);
+      }
+      else if(in == MATCH_OVER) {
+         endGame(&pl);
          break;
+      }
    }
    return EXIT_SUCCESS;
 }
+#endif
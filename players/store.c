@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "store.h"
+
+static const size_t storeLength = sizeof(StoreHeader) + STORE_SLOTS * sizeof(OpponentRecord);
+
+/* Makes an empty store under a temporary name and links it to path, which
+ * fails harmlessly if another player got there first. The records are left
+ * to the file's holes, so a new store takes no room until it is used.
+ */
+static void makeStore(const char *path) {
+   char temp[FILENAME_MAX];
+   StoreHeader h;
+   int fd;
+   snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+   if((fd = mkstemp(temp)) == -1)
+      return;
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, STORE_MAGIC, sizeof(h.magic));
+   h.slots = STORE_SLOTS;
+   h.recordSize = sizeof(OpponentRecord);
+   if(fchmod(fd, 0644) == 0 && ftruncate(fd, storeLength) == 0 &&
+      pwrite(fd, &h, sizeof(h), 0) == sizeof(h) && fsync(fd) == 0)
+      link(temp, path);
+   close(fd);
+   unlink(temp);
+}
+
+/* Maps the store at path, making it first if there is none. A player would
+ * rather play without the store than forfeit, so a store that can't be used
+ * is reported and NULL returned.
+ */
+Store *storeOpen(const char *path) {
+   struct stat st;
+   StoreHeader h;
+   Store *s;
+   int fd = open(path, O_RDWR);
+   if(fd == -1 && errno == ENOENT) {
+      makeStore(path);
+      fd = open(path, O_RDWR);
+   }
+   if(fd == -1 || fstat(fd, &st) == -1) {
+      perror(path);
+      if(fd != -1)
+         close(fd);
+      return NULL;
+   }
+   if(st.st_size != storeLength || pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+      memcmp(h.magic, STORE_MAGIC, sizeof(h.magic)) || h.slots != STORE_SLOTS ||
+      h.recordSize != sizeof(OpponentRecord)) {
+      fprintf(stderr, "%s is not a store\n", path);
+      close(fd);
+      return NULL;
+   }
+   if((s = malloc(sizeof(Store))) == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   s->fd = fd;
+   s->length = storeLength;
+   s->data = mmap(NULL, s->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if(s->data == MAP_FAILED) {
+      perror(path);
+      close(fd);
+      free(s);
+      return NULL;
+   }
+   s->records = (OpponentRecord *)((char *)s->data + sizeof(StoreHeader));
+   return s;
+}
+
+static unsigned int slotOf(const char *name, int size) {
+   unsigned int h = 2166136261u ^ size;
+   for(; *name; name++)
+      h = (h ^ (unsigned char)*name) * 16777619u;
+   return h % STORE_SLOTS;
+}
+
+/* Looks for the record of an opponent along its probe sequence, or returns
+ * the first slot that isn't ready, or -1 when every slot is taken.
+ */
+static int probe(Store *s, const char *name, int size, int *found) {
+   unsigned int slot = slotOf(name, size), i = 0;
+   OpponentRecord *r;
+   for(; i < STORE_SLOTS; i++, slot = (slot + 1) % STORE_SLOTS) {
+      r = &s->records[slot];
+      if(!__atomic_load_n(&r->ready, __ATOMIC_ACQUIRE)) {
+         *found = 0;
+         return slot;
+      }
+      if(r->size == size && strncmp(r->name, name, MAX_NAME) == 0) {
+         *found = 1;
+         return slot;
+      }
+   }
+   return -1;
+}
+
+/* The record of an opponent on a size x size board, made if there is none,
+ * or NULL once the store is full. Records are never taken away, so only
+ * making one needs the lock.
+ */
+OpponentRecord *storeFind(Store *s, const char *name, int size) {
+   OpponentRecord *r;
+   int found, slot = probe(s, name, size, &found);
+   if(slot != -1 && found)
+      return &s->records[slot];
+   flock(s->fd, LOCK_EX);
+   slot = probe(s, name, size, &found);
+   if(slot != -1 && !found) {
+      r = &s->records[slot];
+      r->size = size;
+      memset(r->name, 0, MAX_NAME);
+      strncpy(r->name, name, MAX_NAME - 1);
+      __atomic_store_n(&r->ready, 1, __ATOMIC_RELEASE);
+   }
+   flock(s->fd, LOCK_UN);
+   if(slot == -1)
+      fprintf(stderr, "the store has no room for %s\n", name);
+   return slot != -1 ? &s->records[slot] : NULL;
+}
+
+void storeGame(OpponentRecord *r, int style, int won) {
+   __atomic_fetch_add(&r->games[style], 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&r->wins[style], won != 0, __ATOMIC_RELAXED);
+}
+
+void storeFound(OpponentRecord *r, int cell) {
+   __atomic_fetch_add(&r->found[cell], 1, __ATOMIC_RELAXED);
+}
+
+void storeClose(Store *s) {
+   munmap(s->data, s->length);
+   close(s->fd);
+   free(s);
+}
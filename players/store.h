@@ -0,0 +1,67 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stddef.h>
+#include "battleship.h"
+#include "../protocol.h"
+#include "opponent.h"
+
+/* The ways a player can place its ships: uniformly, weighted away from where
+ * the opponent shoots early, or from a placement book.
+ */
+#define STYLE_UNIFORM 0
+#define STYLE_ADAPTED 1
+#define STYLE_BOOK 2
+#define STYLES 3
+
+/* What a player has learned about one opponent on one size of board, over
+ * every match it has played against it: the games and wins of each way of
+ * placing its ships, how often it found a ship of the opponent's on each
+ * cell, and where the opponent shoots.
+ */
+typedef struct{
+   unsigned int ready;              /* set once size and name are written */
+   unsigned int size;
+   char name[MAX_NAME];
+   unsigned long long games[STYLES], wins[STYLES];
+   unsigned int found[MAX_CELLS];
+   Targeting targeting;
+} OpponentRecord;
+
+/* A store is a StoreHeader followed by STORE_SLOTS records, an open
+ * addressing hash table of the opponents by name and size, mapped shared into
+ * every player using it. Its size doesn't grow with the games in it, so
+ * opening it costs the same after millions of games, and a lookup touches
+ * only the records on its way.
+ *
+ * Counters are added to atomically in place, so players on the same store
+ * can run at once and every count is on disk, or in the page cache, as soon
+ * as it is made. A player that dies halfway through a game leaves the store
+ * whole. A new store is made under another name and linked into place once
+ * it is complete, and a new record is claimed under a lock on the file and
+ * only marked ready once its name is written.
+ */
+#define STORE_MAGIC "BSS1"
+#define STORE_SLOTS 256
+
+typedef struct{
+   char magic[4];
+   unsigned int slots;
+   unsigned int recordSize;
+   unsigned int reserved;
+} StoreHeader;
+
+typedef struct{
+   int fd;
+   void *data;
+   size_t length;
+   OpponentRecord *records;
+} Store;
+
+Store *storeOpen(const char *path);
+OpponentRecord *storeFind(Store *s, const char *name, int size);
+void storeGame(OpponentRecord *r, int style, int won);
+void storeFound(OpponentRecord *r, int cell);
+void storeClose(Store *s);
+
+#endif
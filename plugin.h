@@ -0,0 +1,28 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include "battleship.h"
+#include "protocol.h"
+
+/* The symbol a player shared object exports so the host can run it in-process.
+ * Build a player with -DPLUGIN -shared -fPIC to get a plugin instead of a
+ * standalone program.
+ */
+#define PLUGIN_SYMBOL "battleshipPlayer"
+
+/* Callbacks of an in-process player. Every call gets the pointer returned by
+ * create() so a plugin can run several players at once. onMatchStart is
+ * called right after create() and may be NULL, in which case the plugin only
+ * plays on a SIZE x SIZE board. newGame places the ships in fleet.
+ */
+typedef struct {
+   void *(*create)(const char *args);     /* args is the text after ':' or NULL */
+   void (*newGame)(void *player, Fleet *fleet);
+   Shot (*chooseShot)(void *player);
+   void (*onResult)(void *player, int result);
+   void (*onOpponentShot)(void *player, Shot shot);
+   void (*destroy)(void *player);
+   void (*onMatchStart)(void *player, const MatchStart *start);
+} PlayerPlugin;
+
+#endif
@@ -0,0 +1,330 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include "protocol.h"
+#include "histogram.h"
+#include "placements.h"
+
+void connInit(Conn *c, int rfd, int wfd) {
+   c->rfd = rfd;
+   c->wfd = wfd;
+   c->rx = c->tx = NULL;
+   c->framed = c->pending = 0;
+   c->deadline = 0;
+   c->failed = 0;
+   c->inStart = c->inEnd = c->outLen = 0;
+}
+
+void connInitRing(Conn *c, Ring *rx, Ring *tx, pid_t peer) {
+   connInit(c, -1, -1);
+   c->rx = rx;
+   c->tx = tx;
+   c->peer = peer;
+}
+
+/* Queue the host's half of the handshake. The NEW_GAME that follows it is
+ * still sent as a bare int since the player's answer isn't known yet, and
+ * start waits until it is.
+ */
+void connHello(Conn *c, const MatchStart *start) {
+   int version = PROTOCOL_VERSION;
+   connSend(c, HELLO, &version, sizeof(int));
+   c->framed = -1;
+   c->start = *start;
+}
+
+/* Queue a message. Replies to the host have no type in the old protocol.
+ */
+void connSend(Conn *c, int type, const void *payload, int length) {
+   FrameHeader h;
+   if(c->outLen + sizeof(FrameHeader) + length > CONN_BUFFER)
+      connFlush(c);
+   if(c->framed == 1) {
+      h.type = type;
+      h.length = length;
+      memcpy(c->out + c->outLen, &h, sizeof(h));
+      c->outLen += sizeof(h);
+   }
+   else if(type != BOARD && type != SHOT) {
+      memcpy(c->out + c->outLen, &type, sizeof(int));
+      c->outLen += sizeof(int);
+   }
+   if(length > 0)
+      memcpy(c->out + c->outLen, payload, length);
+   c->outLen += length;
+}
+
+/* Marks the connection as failed. A failure after the deadline is put down to
+ * the deadline.
+ */
+static int fail(Conn *c, int why) {
+   if(c->deadline && why == CONN_CLOSED && monotonicNs() >= c->deadline)
+      why = CONN_TIMEOUT;
+   if(c->failed == 0)
+      c->failed = why;
+   c->outLen = 0;
+   return -1;
+}
+
+/* Send everything queued. Returns -1 once the connection has failed.
+ */
+int connFlush(Conn *c) {
+   if(c->failed)
+      return fail(c, c->failed);
+   if(c->outLen == 0)
+      return 0;
+   if(c->tx ? ringWrite(c->tx, c->out, c->outLen, c->peer, c->deadline) :
+      c->outLen != write(c->wfd, c->out, c->outLen))
+      return fail(c, CONN_CLOSED);
+   c->outLen = 0;
+   return 0;
+}
+
+/* Wait until the pipe can be read or the deadline passes.
+ */
+static int readable(Conn *c) {
+   struct pollfd pfd;
+   long long left;
+   int n;
+   pfd.fd = c->rfd;
+   pfd.events = POLLIN;
+   do {
+      if((left = c->deadline - monotonicNs()) <= 0)
+         return fail(c, CONN_TIMEOUT);
+      n = poll(&pfd, 1, (left + 999999) / 1000000);
+   } while(n == 0 || (n == -1 && errno == EINTR));
+   return n == -1 ? fail(c, CONN_CLOSED) : 0;
+}
+
+/* Make sure at least need bytes are buffered. Anything queued is sent first
+ * since the other side may be waiting for it before it answers.
+ */
+static int fill(Conn *c, int need) {
+   int n;
+   if(c->inEnd - c->inStart >= need)
+      return 0;
+   memmove(c->in, c->in + c->inStart, c->inEnd - c->inStart);
+   c->inEnd -= c->inStart;
+   c->inStart = 0;
+   if(connFlush(c))
+      return -1;
+   while(c->inEnd < need) {
+      if(c->rx)
+         n = ringRead(c->rx, c->in + c->inEnd, CONN_BUFFER - c->inEnd, c->peer,
+            c->deadline);
+      else if(c->deadline && readable(c))
+         return -1;
+      else
+         n = read(c->rfd, c->in + c->inEnd, CONN_BUFFER - c->inEnd);
+      if(n <= 0)
+         return fail(c, CONN_CLOSED);
+      c->inEnd += n;
+   }
+   return 0;
+}
+
+static int take(Conn *c, void *dst, int length) {
+   if(fill(c, length))
+      return -1;
+   memcpy(dst, c->in + c->inStart, length);
+   c->inStart += length;
+   return 0;
+}
+
+/* Payload size of a player-to-host message in the old protocol, where a
+ * board is its cells.
+ */
+static int bareReply(int type) {
+   return type == BOARD ? SIZE * SIZE : sizeof(Shot);
+}
+
+/* Tells from the start of the first reply whether the player understood the
+ * host's HELLO, and if it did takes its HELLO and queues the MATCH_START the
+ * player waits for before it answers.
+ */
+static int greet(Conn *c) {
+   FrameHeader h;
+   int version;
+   memcpy(&h, c->in + c->inStart, sizeof(h));
+   c->framed = (h.type == HELLO && h.length == sizeof(int));
+   if(!c->framed)
+      return 0;
+   c->inStart += sizeof(h);
+   if(take(c, &version, sizeof(int)))
+      return -1;
+   connSend(c, MATCH_START, &c->start, version >= 5 ? sizeof(MatchStart) : V4_START);
+   return 0;
+}
+
+/* Whether a whole reply of the given type is buffered. A player's whole HELLO
+ * counts as well, as connExpect answers it before waiting for the reply. A
+ * frame longer than the buffer counts as buffered, so connExpect turns it
+ * down rather than waiting for it.
+ */
+int connBuffered(Conn *c, int type) {
+   FrameHeader h;
+   int have = c->inEnd - c->inStart;
+   if(c->framed == -1) {
+      if(have < (int)sizeof(h))
+         return 0;
+      memcpy(&h, c->in + c->inStart, sizeof(h));
+      if(h.type == HELLO && h.length == sizeof(int))
+         return have >= (int)(sizeof(h) + sizeof(int));
+   }
+   if(c->framed != 1)
+      return have >= bareReply(type);
+   if(have < (int)sizeof(h))
+      return 0;
+   memcpy(&h, c->in + c->inStart, sizeof(h));
+   return sizeof(h) + h.length > CONN_BUFFER || have >= sizeof(h) + h.length;
+}
+
+/* Answers a player's HELLO once it is buffered whole, then whether a reply of
+ * the given type is.
+ */
+static int greeted(Conn *c, int type) {
+   if(c->framed == -1 && c->inEnd - c->inStart >= (int)(sizeof(FrameHeader) + sizeof(int)) &&
+      (greet(c) || connFlush(c)))
+      return 1;
+   return connBuffered(c, type);
+}
+
+/* Sends anything queued and reads whatever has arrived without waiting, for
+ * a host whose read fd doesn't block. Returns 1 once connExpect can take a
+ * reply of the given type without waiting, or the connection has failed.
+ */
+int connReady(Conn *c, int type) {
+   int n;
+   if(connFlush(c) || greeted(c, type))
+      return 1;
+   memmove(c->in, c->in + c->inStart, c->inEnd - c->inStart);
+   c->inEnd -= c->inStart;
+   c->inStart = 0;
+   n = read(c->rfd, c->in + c->inEnd, CONN_BUFFER - c->inEnd);
+   if(n == -1 && (errno == EAGAIN || errno == EINTR))
+      return 0;
+   if(n <= 0) {
+      fail(c, CONN_CLOSED);
+      return 1;
+   }
+   c->inEnd += n;
+   return greeted(c, type);
+}
+
+/* Used by the player, which can't go on once the host is gone.
+ */
+static void receive(Conn *c, void *dst, int length) {
+   if(take(c, dst, length)) {
+      fprintf(stderr, "read failure in %s at line %d\n", __FILE__, __LINE__);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/* Payload size of a host-to-player message in the old protocol.
+ */
+static int bareLength(int type) {
+   if(type == SHOT_RESULT || type == HELLO)
+      return sizeof(int);
+   if(type == OPPONENTS_SHOT)
+      return sizeof(Shot);
+   return 0;
+}
+
+/* Receive a host-to-player message and return its type. Answers the host's
+ * HELLO and switches to frames if the host asks for them. The NEW_GAME that
+ * comes with the HELLO is then held back until the host's MATCH_START has
+ * been returned, since the board depends on its size.
+ */
+int connRecv(Conn *c, void *payload, int length) {
+   FrameHeader h;
+   int type, version, hostVersion, first;
+   if(c->pending) {
+      type = c->pending;
+      c->pending = 0;
+      return type;
+   }
+   if(c->framed == 1) {
+      receive(c, &h, sizeof(h));
+      if(h.length > length) {
+         fprintf(stderr, "oversized message %d in %s\n", h.type, __FILE__);
+         exit(EXIT_FAILURE);
+      }
+      receive(c, payload, h.length);
+      if(h.type == MATCH_START && ((h.length != sizeof(MatchStart) && h.length != V4_START) ||
+         ((MatchStart *)payload)->size < SIZE || ((MatchStart *)payload)->size > MAX_SIZE)) {
+         fprintf(stderr, "unsupported match start in %s\n", __FILE__);
+         exit(EXIT_FAILURE);
+      }
+      if(h.type == MATCH_START) {
+         if(h.length == V4_START)      // a host of version 4 names no opponent
+            memset(((MatchStart *)payload)->opponent, 0, MAX_NAME);
+         ((MatchStart *)payload)->opponent[MAX_NAME - 1] = '\0';
+      }
+      return h.type;
+   }
+   receive(c, &type, sizeof(int));
+   if(type == HELLO) {
+      receive(c, &hostVersion, sizeof(int));
+      c->framed = 1;
+      version = PROTOCOL_VERSION;
+      connSend(c, HELLO, &version, sizeof(int));
+      receive(c, &type, sizeof(int));
+      if(hostVersion >= 3) {
+         first = connRecv(c, payload, length);
+         c->pending = type;
+         return first;
+      }
+   }
+   if(bareLength(type) > length) {
+      fprintf(stderr, "oversized message %d in %s\n", type, __FILE__);
+      exit(EXIT_FAILURE);
+   }
+   receive(c, payload, bareLength(type));
+   return type;
+}
+
+/* Receive a player's reply of the given type, with a payload of length bytes
+ * in a frame. A player of the old protocol sends its board as cells, so
+ * payload needs room for those when type is BOARD. The first reply tells
+ * whether the player understood the host's HELLO. Returns -1 if the player
+ * failed to reply, with the reason in failed.
+ */
+int connExpect(Conn *c, int type, void *payload, int length) {
+   FrameHeader h;
+   if(c->framed == -1 && (fill(c, sizeof(h)) || greet(c)))
+      return -1;
+   if(c->framed) {
+      if(take(c, &h, sizeof(h)))
+         return -1;
+      if(h.type != type || h.length != length)
+         return fail(c, CONN_INVALID);
+   }
+   else
+      length = bareReply(type);
+   return take(c, payload, length);
+}
+
+/* Queue a player's board, as its cells to a host of the old protocol, which
+ * only plays on a SIZE x SIZE board.
+ */
+void connSendBoard(Conn *c, const Fleet *fleet) {
+   char cells[SIZE][SIZE];
+   int ship = 0, i, row, col;
+   if(c->framed == 1) {
+      connSend(c, BOARD, fleet, sizeof(Fleet));
+      return;
+   }
+   memset(cells, OPEN_WATER, sizeof(cells));
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      for(i = 0; i < fleetLength[ship]; i++) {
+         row = fleet->ships[ship].row + (fleet->ships[ship].down ? i : 0);
+         col = fleet->ships[ship].col + (fleet->ships[ship].down ? 0 : i);
+         if(row < SIZE && col < SIZE)
+            cells[row][col] = (ship + 1) * AIRCRAFT_CARRIER;
+      }
+   }
+   connSend(c, BOARD, cells, sizeof(cells));
+}
@@ -0,0 +1,129 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "battleship.h"
+#include "ring.h"
+
+/* Version of the framed protocol spoken by this host and these players.
+ */
+#define PROTOCOL_VERSION 5
+
+/* Message types added by the framed protocol. HELLO is sent by both sides
+ * during the handshake, BOARD and SHOT are the player's replies to NEW_GAME
+ * and SHOT_REQUEST. MATCH_START carries a MatchStart to the player.
+ */
+#define HELLO 106
+#define BOARD 110
+#define SHOT 111
+#define MATCH_START 112
+
+/* Longest name of a player, with its terminating '\0'.
+ */
+#define MAX_NAME 20
+
+/* What a player is told before the first game of a match. A player should
+ * draw every random choice it makes from seed so a match can be replayed.
+ * The games are played on a size x size board, against the player named
+ * opponent, or "" when it has no name. The name of a plugin opponent ends in
+ * its arguments, after a ':'. A player of version 4 gets only the first
+ * V4_START bytes, which is all its MatchStart holds.
+ */
+typedef struct {
+   unsigned long long seed;
+   unsigned int size;
+   char opponent[MAX_NAME];
+} MatchStart;
+
+#define V4_START 16
+
+/* Where a ship lies: the cell at its top or left end, and whether it runs
+ * down the column from there rather than along the row.
+ */
+typedef struct {
+   unsigned char row, col, down;
+} Placement;
+
+/* A board as a framed player sends it, with a placement for each ship of the
+ * fleet in the order of the ship values. It takes 15 bytes whatever the size
+ * of the board.
+ */
+typedef struct {
+   Placement ships[NUMBER_OF_SHIPS];
+} Fleet;
+
+/* A player's answer to NEW_GAME: a Fleet, or the SIZE*SIZE cells of the
+ * board from a player of the original protocol.
+ */
+typedef union {
+   Fleet fleet;
+   char cells[SIZE][SIZE];
+} BoardReply;
+
+/* Why the other side of a connection stopped answering: it missed the
+ * deadline, closed the connection or died, or sent something that isn't the
+ * reply the host waits for.
+ */
+#define CONN_TIMEOUT 1
+#define CONN_CLOSED 2
+#define CONN_INVALID 3
+
+/* Size of each of the buffers of a connection. A frame never exceeds it.
+ */
+#define CONN_BUFFER 512
+
+/* Every framed message starts with this header, followed by length bytes of
+ * payload.
+ */
+typedef struct {
+   unsigned short type;
+   unsigned short length;
+} FrameHeader;
+
+/* One side of a host-player connection. Outgoing messages are batched in out
+ * until the side has to wait for a reply, and incoming data is read in as
+ * large chunks as are available.
+ *
+ * Old players send and receive bare ints, shots and boards. The host starts
+ * every match with the ints HELLO, PROTOCOL_VERSION and NEW_GAME. An old
+ * player ignores the first two and answers with a 100 byte board. A new
+ * player answers with a HELLO frame carrying its version followed by a BOARD
+ * frame, and both sides use frames from then on. Since version 3 the host
+ * sends a MATCH_START frame as soon as it sees the player's HELLO, and the
+ * player waits for it before answering the NEW_GAME. Since version 4 the
+ * MATCH_START carries the size of the board and a BOARD frame a Fleet, so old
+ * players can only play on a SIZE x SIZE board. Since version 5 it names the
+ * opponent as well.
+ *
+ * The bytes go through a pair of pipes, or through a pair of shared memory
+ * rings when rx and tx are set. peer is then the process on the other side.
+ *
+ * The host waits for a reply until deadline, a time on the monotonic clock in
+ * nanoseconds, or forever while it is 0. Once the player misses it or fails
+ * otherwise, failed says why and the connection is of no more use. A player
+ * has nothing to do without the host and simply exits when it is gone.
+ */
+typedef struct {
+   int rfd, wfd;
+   Ring *rx, *tx;
+   pid_t peer;
+   int framed;       /* 1 when framed, 0 for bare messages, -1 until known */
+   int pending;      /* message held back by the player during the handshake */
+   MatchStart start; /* sent by the host once the player is known to be framed */
+   long long deadline;
+   int failed;       /* CONN_TIMEOUT, CONN_CLOSED or CONN_INVALID, or 0 */
+   int inStart, inEnd, outLen;
+   unsigned char in[CONN_BUFFER], out[CONN_BUFFER];
+} Conn;
+
+void connInit(Conn *c, int rfd, int wfd);
+void connInitRing(Conn *c, Ring *rx, Ring *tx, pid_t peer);
+void connHello(Conn *c, const MatchStart *start);
+void connSend(Conn *c, int type, const void *payload, int length);
+int connFlush(Conn *c);
+int connRecv(Conn *c, void *payload, int length);
+int connExpect(Conn *c, int type, void *payload, int length);
+int connBuffered(Conn *c, int type);
+int connReady(Conn *c, int type);
+void connSendBoard(Conn *c, const Fleet *fleet);
+
+#endif
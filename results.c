@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "results.h"
+#include "histogram.h"
+
+static const char csvHeader[] = "record,match,game,seed,size,player_a,player_b,winner,"
+   "wins_a,wins_b,draws,forfeits_a,forfeits_b,shots_a,hits_a,sinks_a,think_us_a,"
+   "shots_b,hits_b,sinks_b,think_us_b\n";
+
+/* Field names in JSON, or the separators alone in CSV.
+ */
+static const char *jsonFields[] = {"{\"record\":\"", "\",\"match\":", ",\"game\":",
+   ",\"seed\":", ",\"size\":", ",\"player_a\":", ",\"player_b\":", ",\"winner\":\"",
+   "\",\"wins_a\":", ",\"wins_b\":", ",\"draws\":", ",\"forfeits_a\":", ",\"forfeits_b\":",
+   ",\"shots_a\":", ",\"hits_a\":", ",\"sinks_a\":", ",\"think_us_a\":", ",\"shots_b\":",
+   ",\"hits_b\":", ",\"sinks_b\":", ",\"think_us_b\":", "}\n"};
+static const char *csvFields[] = {"", ",", ",", ",", ",", ",", ",", ",", ",", ",", ",", ",",
+   ",", ",", ",", ",", ",", ",", ",", ",", ",", "\n"};
+
+#define FIELDS (sizeof(jsonFields) / sizeof(jsonFields[0]))
+#define NUMBERS 17                /* in a record, each up to 20 digits */
+
+/* One record's numbers, for either seat where there are two.
+ */
+typedef struct{
+   unsigned long long wins[2], draws, forfeits[2];
+   unsigned long long shots[2], hits[2], sinks[2], thinkNs[2];
+} Row;
+
+static void writeOut(Results *r) {
+   size_t done = 0;
+   ssize_t n;
+   while(done < r->used) {
+      n = write(r->fd, r->buffer + done, r->used - done);
+      if(n == -1 && errno == EINTR)
+         continue;
+      if(n == -1) {
+         perror("results");
+         exit(EXIT_FAILURE);
+      }
+      done += n;
+   }
+   r->used = 0;
+}
+
+/* Quotes a name for JSON, or for CSV when it holds anything a CSV reader
+ * would split it on.
+ */
+static void quoteName(char *out, const char *name, int csv) {
+   int quote = !csv || strpbrk(name, ",\"\r\n") != NULL;
+   if(quote)
+      *out++ = '"';
+   for(; *name; name++) {
+      if(csv && *name == '"')
+         *out++ = '"';
+      else if(!csv && (*name == '"' || *name == '\\'))
+         *out++ = '\\';
+      else if(!csv && (unsigned char)*name < 0x20) {
+         out += sprintf(out, "\\u%04x", *name);
+         continue;
+      }
+      *out++ = *name;
+   }
+   if(quote)
+      *out++ = '"';
+   *out = '\0';
+}
+
+/* The longest a record can be: its field names or separators, the names of
+ * the players, the longest kind and winner, and 20 digits for each number.
+ */
+static size_t longestRecord(const Results *r) {
+   const char **f = r->csv ? csvFields : jsonFields;
+   size_t n = strlen("match") + strlen("draw") + strlen(r->names[0]) + strlen(r->names[1]) +
+      NUMBERS * 20;
+   int i = 0;
+   for(; i < FIELDS; i++)
+      n += strlen(f[i]);
+   return n;
+}
+
+Results *resultsCreate(const char *path, int csv, long long flushNs, char *nA, char *nB,
+   int size) {
+   Results *r = malloc(sizeof(Results));
+   if(r == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   if((r->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+   r->csv = csv;
+   r->flushNs = flushNs;
+   r->flushed = monotonicNs();
+   r->size = size;
+   quoteName(r->names[0], nA, csv);
+   quoteName(r->names[1], nB, csv);
+   r->longest = longestRecord(r);
+   r->used = 0;
+   if(csv) {
+      memcpy(r->buffer, csvHeader, sizeof(csvHeader) - 1);
+      r->used = sizeof(csvHeader) - 1;
+   }
+   return r;
+}
+
+static char *putText(char *out, const char *text) {
+   while(*text)
+      *out++ = *text++;
+   return out;
+}
+
+static char *putNumber(char *out, unsigned long long v) {
+   char digits[20];
+   int n = 0;
+   do
+      digits[n++] = '0' + v % 10;
+   while((v /= 10) != 0);
+   while(n > 0)
+      *out++ = digits[--n];
+   return out;
+}
+
+/* Records are put together by hand rather than with printf, which would take
+ * a few times as long as the rest of the record.
+ */
+static void addRecord(Results *r, const char *kind, unsigned long long match,
+   unsigned long long game, unsigned long long seed, const char *winner, const Row *w) {
+   const char **f = r->csv ? csvFields : jsonFields;
+   char *out;
+   long long now;
+   int seat = 0;
+   if(r->used + r->longest > RESULTS_BUFFER)
+      writeOut(r);
+   out = r->buffer + r->used;
+   out = putText(putText(out, f[0]), kind);
+   out = putNumber(putText(out, f[1]), match);
+   out = putNumber(putText(out, f[2]), game);
+   out = putNumber(putText(out, f[3]), seed);
+   out = putNumber(putText(out, f[4]), r->size);
+   out = putText(putText(out, f[5]), r->names[0]);
+   out = putText(putText(out, f[6]), r->names[1]);
+   out = putText(putText(out, f[7]), winner);
+   out = putNumber(putText(out, f[8]), w->wins[0]);
+   out = putNumber(putText(out, f[9]), w->wins[1]);
+   out = putNumber(putText(out, f[10]), w->draws);
+   out = putNumber(putText(out, f[11]), w->forfeits[0]);
+   out = putNumber(putText(out, f[12]), w->forfeits[1]);
+   for(; seat < 2; seat++) {
+      out = putNumber(putText(out, f[13 + 4*seat]), w->shots[seat]);
+      out = putNumber(putText(out, f[14 + 4*seat]), w->hits[seat]);
+      out = putNumber(putText(out, f[15 + 4*seat]), w->sinks[seat]);
+      out = putNumber(putText(out, f[16 + 4*seat]), w->thinkNs[seat] / 1000);
+   }
+   out = putText(out, f[21]);
+   r->used = out - r->buffer;
+   now = monotonicNs();
+   if(now - r->flushed >= r->flushNs) {
+      writeOut(r);
+      r->flushed = now;
+   }
+}
+
+/* Takes the wins the game ended with and the scores before endGame adds them
+ * to the totals.
+ */
+void resultsGame(Results *r, unsigned long long match, unsigned long long game,
+   unsigned long long seed, int (*wins)[2], const Score *a, const Score *b) {
+   const char *winner = "none";
+   Row w;
+   if(a->forfeited || b->forfeited)
+      winner = a->forfeited == b->forfeited ? "none" : a->forfeited ? "b" : "a";
+   else if((*wins)[0] && (*wins)[1])
+      winner = "draw";
+   else if((*wins)[0] || (*wins)[1])
+      winner = (*wins)[0] ? "a" : "b";
+   w.draws = !a->forfeited && !b->forfeited && (*wins)[0] && (*wins)[1];
+   w.wins[0] = (*wins)[0] && !w.draws;
+   w.wins[1] = (*wins)[1] && !w.draws;
+   w.forfeits[0] = a->forfeited;
+   w.forfeits[1] = b->forfeited;
+   w.shots[0] = a->hits + a->misses;
+   w.shots[1] = b->hits + b->misses;
+   w.hits[0] = a->hits;
+   w.hits[1] = b->hits;
+   w.sinks[0] = a->sinks;
+   w.sinks[1] = b->sinks;
+   w.thinkNs[0] = a->thinkNs;
+   w.thinkNs[1] = b->thinkNs;
+   addRecord(r, "game", match, game, seed, winner, &w);
+}
+
+/* Takes the totals of the match.
+ */
+void resultsMatch(Results *r, unsigned long long match, unsigned long long games,
+   unsigned long long seed, const Score *a, const Score *b) {
+   Row w;
+   w.wins[0] = a->wins;
+   w.wins[1] = b->wins;
+   w.draws = a->draws;
+   w.forfeits[0] = a->forfeits;
+   w.forfeits[1] = b->forfeits;
+   w.shots[0] = a->totalHits + a->totalMisses;
+   w.shots[1] = b->totalHits + b->totalMisses;
+   w.hits[0] = a->totalHits;
+   w.hits[1] = b->totalHits;
+   w.sinks[0] = a->totalSinks;
+   w.sinks[1] = b->totalSinks;
+   w.thinkNs[0] = a->totalThinkNs;
+   w.thinkNs[1] = b->totalThinkNs;
+   addRecord(r, "match", match, games, seed,
+      a->wins > b->wins ? "a" : b->wins > a->wins ? "b" : "draw", &w);
+}
+
+void resultsClose(Results *r) {
+   writeOut(r);
+   if(close(r->fd) == -1) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   free(r);
+}
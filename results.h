@@ -0,0 +1,45 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include "match.h"
+
+/* Results of games and matches written for programs rather than people, one
+ * record per line as CSV (with a header line) or JSON:
+ *
+ *    record         "game" or "match"
+ *    match          number of the match, from 0
+ *    game           number of the game in the match from 1, or for a match
+ *                   record the games it played
+ *    seed, size     of the match and its board
+ *    player_a/b     names of the players
+ *    winner         "a", "b", "draw" or "none" when nobody won the game
+ *    wins_a/b, draws, forfeits_a/b
+ *    shots, hits, sinks and think_us of each player, think_us being the
+ *                   microseconds it took to answer the host
+ *
+ * A record is put into a buffer that goes out in one write once it is nearly
+ * full or flushNs has passed since the last write, so a record costs well under
+ * a microsecond and the file is never far behind the games.
+ */
+#define RESULTS_BUFFER (1 << 16)
+#define FLUSH_MS 1000             /* default time between writes */
+
+typedef struct{
+   int fd, csv;
+   long long flushNs, flushed;   /* write out the buffer at most flushNs apart */
+   int size;
+   char names[2][6 * MAX_NAME + 3];    /* quoted and escaped as the format needs */
+   size_t longest;                     /* a record can take, with these names */
+   size_t used;
+   char buffer[RESULTS_BUFFER];
+} Results;
+
+Results *resultsCreate(const char *path, int csv, long long flushNs, char *nA, char *nB,
+   int size);
+void resultsGame(Results *r, unsigned long long match, unsigned long long game,
+   unsigned long long seed, int (*wins)[2], const Score *a, const Score *b);
+void resultsMatch(Results *r, unsigned long long match, unsigned long long games,
+   unsigned long long seed, const Score *a, const Score *b);
+void resultsClose(Results *r);
+
+#endif
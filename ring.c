@@ -0,0 +1,169 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include "ring.h"
+#include "histogram.h"
+
+/* Number of checks before a waiting side goes to sleep, and how long it sleeps
+ * before checking that the other side is still alive. Spinning is skipped on
+ * a single CPU where the other side can't run while this one spins.
+ */
+#define SPINS 2000
+#define SLEEP_NS 100000000
+
+static void cpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#endif
+}
+
+/* Create the shared memory for a new connection. fd can be passed on to the
+ * player, and is closed on exec until the player's side clears the flag.
+ */
+RingPair *ringCreate(int *fd) {
+   RingPair *rings;
+   if((*fd = memfd_create("battleship", MFD_CLOEXEC)) == -1 ||
+      ftruncate(*fd, sizeof(RingPair)) == -1) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   rings = mmap(NULL, sizeof(RingPair), PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+   if(rings == MAP_FAILED) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   return rings;
+}
+
+RingPair *ringAttach(int fd) {
+   RingPair *rings;
+   rings = mmap(NULL, sizeof(RingPair), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if(rings == MAP_FAILED) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   close(fd);
+   return rings;
+}
+
+void ringRelease(RingPair *rings) {
+   munmap(rings, sizeof(RingPair));
+}
+
+/* A player is gone once it has exited, the host once it no longer exists.
+ * The player is left for the host to reap when it stops it, so its pid can't
+ * be taken by another process while the host still kills and waits on it.
+ */
+static int peerGone(pid_t peer) {
+   siginfo_t info;
+   info.si_pid = 0;
+   if(kill(peer, 0) == -1)
+      return 1;
+   return waitid(P_PID, peer, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == peer;
+}
+
+static void wake(_Atomic unsigned *word, _Atomic unsigned *waiter) {
+   if(atomic_load(waiter))
+      syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/* Wait until word no longer holds seen. The waiter flag is set before word is
+ * checked again so the other side either sees the flag or this side sees the
+ * new value. Returns -1 if the other side died instead, or if deadline (on the
+ * monotonic clock, 0 for none) passed first.
+ */
+static int waitChange(_Atomic unsigned *word, _Atomic unsigned *waiter,
+   unsigned seen, pid_t peer, long long deadline) {
+   static int spins = -1;
+   struct timespec ts = {0, SLEEP_NS};
+   long long left;
+   int i = 0;
+   if(spins == -1)
+      spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPINS : 0;
+   for(; i < spins; i++) {
+      if(atomic_load_explicit(word, memory_order_acquire) != seen)
+         return 0;
+      cpuRelax();
+   }
+   while(1) {
+      atomic_store(waiter, 1);
+      if(atomic_load(word) != seen)
+         break;
+      if(deadline) {
+         if((left = deadline - monotonicNs()) <= 0) {
+            atomic_store(waiter, 0);
+            return -1;
+         }
+         ts.tv_nsec = left < SLEEP_NS ? left : SLEEP_NS;
+      }
+      syscall(SYS_futex, word, FUTEX_WAIT, seen, &ts, NULL, 0);
+      if(atomic_load(word) != seen)
+         break;
+      if(peerGone(peer)) {
+         atomic_store(waiter, 0);
+         return -1;
+      }
+   }
+   atomic_store(waiter, 0);
+   return 0;
+}
+
+/* Copy all of buf into the ring, waiting for room when it is full.
+ * Returns -1 if the other side died or deadline passed.
+ */
+int ringWrite(Ring *r, const void *buf, int length, pid_t peer, long long deadline) {
+   const unsigned char *in = buf;
+   unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed), tail;
+   unsigned n, at, first;
+   while(length > 0) {
+      tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+      if(head - tail == RING_SIZE) {
+         if(waitChange(&r->tail, &r->tailWaiter, tail, peer, deadline))
+            return -1;
+         continue;
+      }
+      n = RING_SIZE - (head - tail);
+      n = n < (unsigned)length ? n : (unsigned)length;
+      at = head & (RING_SIZE - 1);
+      first = n < RING_SIZE - at ? n : RING_SIZE - at;
+      memcpy(r->data + at, in, first);
+      memcpy(r->data, in + first, n - first);
+      head += n;
+      in += n;
+      length -= n;
+      atomic_store(&r->head, head);
+      wake(&r->head, &r->headWaiter);
+   }
+   return 0;
+}
+
+/* Copy whatever the ring holds, up to max bytes, waiting for at least one.
+ * Returns the number of bytes read, or -1 if the other side died or deadline
+ * passed.
+ */
+int ringRead(Ring *r, void *buf, int max, pid_t peer, long long deadline) {
+   unsigned char *out = buf;
+   unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed), head;
+   unsigned n, at, first;
+   while((head = atomic_load_explicit(&r->head, memory_order_acquire)) == tail) {
+      if(waitChange(&r->head, &r->headWaiter, tail, peer, deadline))
+         return -1;
+   }
+   n = head - tail < (unsigned)max ? head - tail : (unsigned)max;
+   at = tail & (RING_SIZE - 1);
+   first = n < RING_SIZE - at ? n : RING_SIZE - at;
+   memcpy(out, r->data + at, first);
+   memcpy(out + first, r->data, n - first);
+   atomic_store(&r->tail, tail + n);
+   wake(&r->tail, &r->tailWaiter);
+   return n;
+}
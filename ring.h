@@ -0,0 +1,41 @@
+#ifndef RING_H
+#define RING_H
+
+#include <sys/types.h>
+
+/* Bytes in each direction of a shared memory connection. A power of two.
+ */
+#define RING_SIZE 4096
+
+/* Argument a player gets in place of its read fd when it should talk to the
+ * host through shared memory. The second argument is then the fd of the
+ * shared memory holding a RingPair.
+ */
+#define SHM_ARG "shm"
+
+/* Single producer, single consumer byte queue in shared memory. The producer
+ * only moves head and the consumer only moves tail, each on its own cache
+ * line. A side that finds the ring empty (or full) spins for a while and then
+ * sleeps on a futex, setting its waiter flag so the other side wakes it.
+ * Reads and writes give up at deadline, a time on the monotonic clock in
+ * nanoseconds, unless it is 0.
+ */
+typedef struct {
+   _Atomic unsigned head __attribute__((aligned(64)));
+   _Atomic unsigned headWaiter;
+   _Atomic unsigned tail __attribute__((aligned(64)));
+   _Atomic unsigned tailWaiter;
+   unsigned char data[RING_SIZE] __attribute__((aligned(64)));
+} Ring;
+
+typedef struct {
+   Ring toPlayer, fromPlayer;
+} RingPair;
+
+RingPair *ringCreate(int *fd);
+RingPair *ringAttach(int fd);
+void ringRelease(RingPair *rings);
+int ringWrite(Ring *r, const void *buf, int length, pid_t peer, long long deadline);
+int ringRead(Ring *r, void *buf, int max, pid_t peer, long long deadline);
+
+#endif
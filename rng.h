@@ -0,0 +1,20 @@
+#ifndef RNG_H
+#define RNG_H
+
+/* Small random number generator (splitmix64) for the host and the players.
+ * Its whole state is one number, so a seed is enough to repeat a run.
+ */
+static inline unsigned long long rngNext(unsigned long long *state) {
+   unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL);
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+   return z ^ (z >> 31);
+}
+
+/* A number from 0 to n - 1, off from uniform by at most n / 2^32.
+ */
+static inline unsigned rngBelow(unsigned long long *state, unsigned n) {
+   return (unsigned)(((rngNext(state) >> 32) * n) >> 32);
+}
+
+#endif
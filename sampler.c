@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "sampler.h"
+#include "rng.h"
+
+static void *allocate(size_t size) {
+   void *p = malloc(size);
+   if(p == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   return p;
+}
+
+/* Lists where each placement starts, as a Fleet gives it.
+ */
+static void listPlacements(FleetSampler *s) {
+   const PlacementTable *t = s->table;
+   int ship = 0, n, cell, down;
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      for(n = t->shipPlacements[ship]; n < t->shipPlacements[ship + 1]; n++) {
+         cell = placementStart(t->size, fleetLength[ship], n - t->shipPlacements[ship], &down);
+         s->placements[n].row = cell / t->size;
+         s->placements[n].col = cell % t->size;
+         s->placements[n].down = down;
+      }
+   }
+}
+
+FleetSampler *samplerCreate(void) {
+   FleetSampler *s = allocate(sizeof(FleetSampler));
+   s->table = placementsCreate(SIZE);
+   s->rng = 0;
+   clearCells(&s->used, BOARD_WORDS);
+   listPlacements(s);
+   s->weighted = 0;
+   return s;
+}
+
+/* Seeds the sampler for a match, and builds the placements again when the
+ * match is played on a board of another size. The placements are uniform
+ * until samplerWeigh says otherwise.
+ */
+void samplerStart(FleetSampler *s, unsigned long long seed, int size) {
+   s->rng = seed;
+   if(s->table->size != size) {
+      placementsFree(s->table);
+      s->table = placementsCreate(size);
+      listPlacements(s);
+   }
+   s->weighted = 0;
+}
+
+/* Builds the alias table of one ship with Vose's method: a placement whose
+ * share is below the average is topped up by one above it, which then has that
+ * much less to give.
+ */
+static void buildAlias(FleetSampler *s, int first, int last, double *share, int *small,
+   int *large) {
+   int ns = 0, nl = 0, i = first, lo, hi;
+   for(; i < last; i++) {
+      if(share[i] < 1.0)
+         small[ns++] = i;
+      else
+         large[nl++] = i;
+   }
+   while(ns > 0 && nl > 0) {
+      lo = small[--ns];
+      hi = large[nl - 1];
+      s->threshold[lo] = (unsigned int)(share[lo] * 4294967296.0);
+      s->alias[lo] = hi;
+      share[hi] -= 1.0 - share[lo];
+      if(share[hi] < 1.0) {
+         nl--;
+         small[ns++] = hi;
+      }
+   }
+   while(nl > 0) {
+      i = large[--nl];
+      s->threshold[i] = 0;
+      s->alias[i] = i;
+   }
+   while(ns > 0) {      // left over by rounding, as good as 1
+      i = small[--ns];
+      s->threshold[i] = 0;
+      s->alias[i] = i;
+   }
+}
+
+/* Weighs every placement by the product of the weights of its cells, or
+ * all of them the same with NULL. A ship whose placements all weigh nothing
+ * is drawn uniformly.
+ */
+void samplerWeigh(FleetSampler *s, const double *cellWeights) {
+   const PlacementTable *t = s->table;
+   double *share, total;
+   int *small, *large, ship = 0, n, j;
+   if(cellWeights == NULL) {
+      s->weighted = 0;
+      return;
+   }
+   s->weighted = 1;
+   share = allocate(t->count * sizeof(double));
+   small = allocate(t->count * sizeof(int));
+   large = allocate(t->count * sizeof(int));
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      total = 0.0;
+      for(n = t->shipPlacements[ship]; n < t->shipPlacements[ship + 1]; n++) {
+         share[n] = 1.0;
+         for(j = 0; j < fleetLength[ship]; j++)
+            share[n] *= cellWeights[t->placementCells[n][j]];
+         total += share[n];
+      }
+      for(n = t->shipPlacements[ship]; n < t->shipPlacements[ship + 1]; n++)
+         share[n] = total > 0.0 ? share[n] * (t->shipPlacements[ship + 1] -
+            t->shipPlacements[ship]) / total : 1.0;
+      buildAlias(s, t->shipPlacements[ship], t->shipPlacements[ship + 1], share, small, large);
+   }
+   free(share);
+   free(small);
+   free(large);
+}
+
+/* One placement of a ship: a slot drawn from the high half of a number and,
+ * when weighted, the slot's own placement or its alias from the low half.
+ */
+static int drawShip(FleetSampler *s, int ship) {
+   unsigned long long r = rngNext(&s->rng);
+   int first = s->table->shipPlacements[ship];
+   int n = first + (int)(((r >> 32) * (s->table->shipPlacements[ship + 1] - first)) >> 32);
+   if(!s->weighted)
+      return n;
+   return (unsigned int)r < s->threshold[n] ? n : s->alias[n];
+}
+
+static int drawMasked(FleetSampler *s, int *placed) {
+   unsigned long long used[2] = {0, 0};
+   const unsigned long long *m;
+   int ship = 0;
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      placed[ship] = drawShip(s, ship);
+      m = s->table->placementMask[placed[ship]];
+      if((used[0] & m[0]) | (used[1] & m[1]))
+         return 0;
+      used[0] |= m[0];
+      used[1] |= m[1];
+   }
+   return 1;
+}
+
+/* Marks the cells of each ship in used, and takes the marks away again
+ * before it returns.
+ */
+static int drawCells(FleetSampler *s, int *placed) {
+   const PlacementTable *t = s->table;
+   int ship = 0, j, clash = 0, last;
+   for(; ship < NUMBER_OF_SHIPS && !clash; ship++) {
+      placed[ship] = drawShip(s, ship);
+      for(j = 0; j < fleetLength[ship]; j++)
+         clash |= hasCell(&s->used, t->placementCells[placed[ship]][j]);
+      if(!clash) {
+         for(j = 0; j < fleetLength[ship]; j++)
+            addCell(&s->used, t->placementCells[placed[ship]][j]);
+      }
+   }
+   last = clash ? ship - 1 : ship;
+   for(ship = 0; ship < last; ship++) {
+      for(j = 0; j < fleetLength[ship]; j++)
+         s->used.words[t->placementCells[placed[ship]][j] >> 6] = 0;
+   }
+   return !clash;
+}
+
+/* Rejects fleets until one has no two ships on a cell.
+ */
+void samplerDraw(FleetSampler *s, Fleet *fleet) {
+   int placed[NUMBER_OF_SHIPS], ship = 0;
+   if(s->table->placementMask != NULL) {
+      while(!drawMasked(s, placed))
+         ;
+   }
+   else {
+      while(!drawCells(s, placed))
+         ;
+   }
+   for(; ship < NUMBER_OF_SHIPS; ship++)
+      fleet->ships[ship] = s->placements[placed[ship]];
+}
+
+void samplerFree(FleetSampler *s) {
+   placementsFree(s->table);
+   free(s);
+}
@@ -0,0 +1,37 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "protocol.h"
+#include "placements.h"
+
+/* Draws legal fleets from the placements of a table, either uniformly over all
+ * the fleets with no two ships on a cell, or with each fleet weighted by the
+ * product of the weights of the cells its ships cover. The table is built for
+ * the size of the board, which samplerStart sets for a match along with the
+ * seed, so the same seed draws the same fleets.
+ *
+ * This is rejection sampling. Every ship is drawn from its placements in
+ * constant time, through an alias table when they are weighted, and the
+ * whole fleet is thrown away and drawn again if two ships share a cell, which
+ * keeps the distribution exact. Drawing only the clashing ship again would
+ * favour the placements that clash with nothing. More than half the fleets
+ * drawn on a 10x10 board are rejected, under a third on 16x16 and almost none
+ * on the largest boards, so a fleet takes a few hundred nanoseconds at most.
+ */
+typedef struct{
+   PlacementTable *table;
+   unsigned long long rng;
+   int weighted;
+   unsigned int threshold[MAX_PLACEMENTS];   /* of each placement, out of 2^32 */
+   unsigned short alias[MAX_PLACEMENTS];     /* placement taken above the threshold */
+   Placement placements[MAX_PLACEMENTS];     /* where each placement starts */
+   Bitboard used;                            /* scratch beyond MASK_CELLS cells */
+} FleetSampler;
+
+FleetSampler *samplerCreate(void);
+void samplerStart(FleetSampler *s, unsigned long long seed, int size);
+void samplerWeigh(FleetSampler *s, const double *cellWeights);
+void samplerDraw(FleetSampler *s, Fleet *fleet);
+void samplerFree(FleetSampler *s);
+
+#endif
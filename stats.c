@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+
+Stats *statsCreate(int size) {
+   Stats *s = malloc(sizeof(Stats));
+   if(s == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   s->size = size;
+   statsClear(s);
+   return s;
+}
+
+void statsClear(Stats *s) {
+   int size = s->size;
+   memset(s, 0, sizeof(Stats));
+   s->size = size;
+}
+
+/* Counts a shot once the score has taken it in, so shots, hits and sinks
+ * include it. Shots off the board only count towards the histograms.
+ */
+void statsShot(Stats *s, Shot shot, int result, unsigned int shots,
+   unsigned int hits, unsigned int sinks) {
+   int cell = shot.row * s->size + shot.col;
+   if(shot.row < s->size && shot.col < s->size) {
+      s->shots[cell]++;
+      s->hits[cell] += result != MISS;
+   }
+   if(result != MISS && hits == 1)
+      s->firstHit[shots]++;
+   if(result == SINK && sinks == 1)
+      s->firstSink[shots]++;
+}
+
+/* Counts the cells of the ships a player placed, given the ship at each
+ * cell or 0 for open water.
+ */
+void statsBoard(Stats *s, const unsigned char *shipAt) {
+   int cells = s->size * s->size, cell = 0;
+   for(; cell < cells; cell++)
+      s->ships[cell] += shipAt[cell] != 0;
+}
+
+/* Counts a game that ended after the player fired shots shots.
+ */
+void statsGame(Stats *s, unsigned int shots, unsigned int sinks) {
+   s->games++;
+   if(sinks == NUMBER_OF_SHIPS)
+      s->win[shots]++;
+}
+
+void statsMerge(Stats *into, const Stats *from) {
+   int cells = into->size * into->size, i = 0;
+   into->games += from->games;
+   for(; i < cells; i++) {
+      into->shots[i] += from->shots[i];
+      into->hits[i] += from->hits[i];
+      into->ships[i] += from->ships[i];
+   }
+   for(i = 0; i <= cells; i++) {
+      into->firstHit[i] += from->firstHit[i];
+      into->firstSink[i] += from->firstSink[i];
+      into->win[i] += from->win[i];
+   }
+}
+
+static void writeCells(FILE *out, const char *name, const unsigned long long *counts,
+   int cells) {
+   int i = 0;
+   fprintf(out, ",\"%s\":[", name);
+   for(; i < cells; i++)
+      fprintf(out, "%s%llu", i ? "," : "", counts[i]);
+   fprintf(out, "]");
+}
+
+/* Writes a histogram of shot counts as its count, mean and the [shots,games]
+ * pairs that aren't 0.
+ */
+static void writeShots(FILE *out, const char *name, const unsigned long long *counts,
+   int cells) {
+   unsigned long long total = 0, sum = 0;
+   int i = 1, first = 1;
+   for(; i <= cells; i++) {
+      total += counts[i];
+      sum += counts[i] * i;
+   }
+   fprintf(out, ",\"%s\":{\"count\":%llu,\"mean\":%.2f,\"shots\":[", name, total,
+      total ? (double)sum / total : 0.0);
+   for(i = 1; i <= cells; i++) {
+      if(counts[i] == 0)
+         continue;
+      fprintf(out, "%s[%d,%llu]", first ? "" : ",", i, counts[i]);
+      first = 0;
+   }
+   fprintf(out, "]}");
+}
+
+void statsWriteJson(FILE *out, const Stats *s) {
+   int cells = s->size * s->size;
+   fprintf(out, "{\"size\":%d,\"games\":%llu", s->size, s->games);
+   writeCells(out, "shots", s->shots, cells);
+   writeCells(out, "hits", s->hits, cells);
+   writeCells(out, "ships", s->ships, cells);
+   writeShots(out, "first_hit", s->firstHit, cells);
+   writeShots(out, "first_sink", s->firstSink, cells);
+   writeShots(out, "win", s->win, cells);
+   fprintf(out, "}");
+}
@@ -0,0 +1,38 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "battleship.h"
+#include "bitboard.h"
+
+/* Counts gathered for one player over many games on a size x size board:
+ *
+ *    shots, hits    how often the player fired at each cell and hit
+ *    ships          how often it put a ship on each cell
+ *    firstHit, firstSink, win
+ *                   how many games it took n shots to get its first hit, to
+ *                   sink its first ship and to sink all five, for n from 1
+ *                   to size*size
+ *
+ * Cells are numbered row*size + col. Every count is a plain counter, so the
+ * counts of several games, matches or threads add up with statsMerge, and a
+ * shot costs a few increments.
+ */
+typedef struct{
+   int size;
+   unsigned long long games;
+   unsigned long long shots[MAX_CELLS], hits[MAX_CELLS], ships[MAX_CELLS];
+   unsigned long long firstHit[MAX_CELLS + 1], firstSink[MAX_CELLS + 1];
+   unsigned long long win[MAX_CELLS + 1];
+} Stats;
+
+Stats *statsCreate(int size);
+void statsClear(Stats *s);
+void statsShot(Stats *s, Shot shot, int result, unsigned int shots,
+   unsigned int hits, unsigned int sinks);
+void statsBoard(Stats *s, const unsigned char *shipAt);
+void statsGame(Stats *s, unsigned int shots, unsigned int sinks);
+void statsMerge(Stats *into, const Stats *from);
+void statsWriteJson(FILE *out, const Stats *s);
+
+#endif
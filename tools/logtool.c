@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include "../gamelog.h"
+
+/* Prints the totals of a game log written by "battleship --record", or one
+ * game of it in full.
+ * Usage: logtool [-g game] log
+ */
+
+static void printFileUsage() {
+   fprintf(stderr, "Usage: logtool [-g game] log\n");
+   fprintf(stderr, "\t-g\tprint the boards and shots of one game (counted from 1)\n");
+   exit(EXIT_FAILURE);
+}
+
+static double now(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Reads only the summary of every game, which is as fast as the log can be
+ * scanned.
+ */
+static void printTotals(LogReader *r) {
+   GameSummary s;
+   unsigned long long games = 0, shots = 0, wins[2] = {0}, draws = 0;
+   unsigned long long hits[2] = {0}, sinks[2] = {0}, forfeits[2] = {0};
+   double start = now(), took;
+   int seat;
+   while(logSummary(r, &s)) {
+      games++;
+      shots += s.shotCount;
+      draws += s.wins[0] && s.wins[1];
+      for(seat = 0; seat < 2; seat++) {
+         wins[seat] += s.wins[seat] && !s.wins[1 - seat];
+         hits[seat] += s.hits[seat];
+         sinks[seat] += s.sinks[seat];
+         forfeits[seat] += s.forfeits[seat];
+      }
+   }
+   took = now() - start;
+   printf("Seed: %llu\n", r->header.seed);
+   printf("%llu games, %.2f shots per game\n", games, games ? (double)shots / games : 0.0);
+   for(seat = 0; seat < 2; seat++) {
+      printf("%16s: %llu wins, %llu draws, %llu losses, ", r->header.names[seat],
+         wins[seat], draws, games - wins[seat] - draws);
+      printf("%llu hits, %llu sinks, %llu forfeits\n", hits[seat], sinks[seat],
+         forfeits[seat]);
+   }
+   fprintf(stderr, "scanned in %.3f s, %.0f games/s\n", took, took > 0 ? games / took : 0.0);
+}
+
+/* Prints the value of the ship on each cell, as a board of the original
+ * protocol would hold it.
+ */
+static void printBoard(const Bitboard *ships, int size) {
+   int cell = 0, ship, value;
+   for(; cell < size * size; cell++) {
+      for(value = OPEN_WATER, ship = 0; ship < NUMBER_OF_SHIPS; ship++) {
+         if(hasCell(&ships[ship], cell))
+            value = (ship + 1) * AIRCRAFT_CARRIER;
+      }
+      printf("%3d%s", value, cell % size == size - 1 ? "\n" : "");
+   }
+}
+
+static void printGame(LogReader *r, unsigned long long n) {
+   GameRecord game;
+   unsigned long long i = 0;
+   int seat, shot;
+   for(; i < n; i++) {
+      if(!logNext(r, &game)) {
+         fprintf(stderr, "the log holds %llu games\n", i);
+         exit(EXIT_FAILURE);
+      }
+   }
+   printf("Game %llu: %d shots on a %dx%d board\n", n, game.shotCount, game.size, game.size);
+   for(seat = 0; seat < 2; seat++) {
+      printf("\n%s%s%s: %u hits, %u sinks\n", r->header.names[seat],
+         game.wins[seat] ? " won" : "", game.forfeits[seat] ? " forfeited" : "",
+         game.hits[seat], game.sinks[seat]);
+      printBoard(game.ships[seat], game.size);
+      printf("shots:");
+      for(shot = seat; shot < game.shotCount; shot += 2)
+         printf(" %d,%d", game.shots[shot].row, game.shots[shot].col);
+      printf("\n");
+   }
+}
+
+int main(int argc, char **argv) {
+   LogReader r;
+   unsigned long long game = 0;
+   char *end;
+   int c;
+   while((c = getopt(argc, argv, "g:")) != -1) {
+      if(c == 'g') {
+         game = strtoull(optarg, &end, 10);
+         if(*optarg == '-' || *end != '\0' || game == 0)
+            printFileUsage();
+      }
+      else
+         printFileUsage();
+   }
+   if(argc - optind != 1)
+      printFileUsage();
+   logOpen(&r, argv[optind]);
+   if(game)
+      printGame(&r, game);
+   else
+      printTotals(&r);
+   logRelease(&r);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "../players/density.h"
+#include "../book.h"
+
+/* Writes an opening book (book.h) of the shots the smart player's density
+ * engine fires for every run of results over the first depth shots.
+ * Usage: openings [-b size] [-d depth] [-t threads] [-S seed] book
+ *
+ * The book is filled in a level at a time, and the nodes of a level are
+ * shared out between threads on all cores. Each node is found by playing its
+ * results back into an engine started from the seed, so the engine breaks
+ * its ties the same way at every node and the shots of the book follow on
+ * from each other. A node no game gets to, below a sink no ship fits or once
+ * the whole fleet has sunk, is left empty along with everything under it.
+ */
+
+#define DEPTH 10
+#define NODES_PER_TAKE 64
+
+typedef struct{
+   int size, depth, workers;
+   unsigned long long seed;
+   unsigned short *cells;
+   unsigned int next, end;       /* the next node of the level to take and its end */
+   pthread_mutex_t lock;         /* protects next */
+} Builder;
+
+typedef struct{
+   Builder *b;
+   Density *engine;
+} Worker;
+
+static void printFileUsage() {
+   fprintf(stderr, "Usage: openings [-b size] [-d depth] [-t threads] [-S seed] book\n");
+   fprintf(stderr, "\t-b\tplay on a size x size board, %d to %d (default %d)\n",
+      SIZE, MAX_SIZE, SIZE);
+   fprintf(stderr, "\t-d\tshots the book covers, 1 to %d (default %d)\n", MAX_DEPTH, DEPTH);
+   fprintf(stderr, "\t-t\tnumber of threads (default one per core)\n");
+   fprintf(stderr, "\t-S\tseed the engine breaks its ties from (default from the clock)\n");
+   exit(EXIT_FAILURE);
+}
+
+static unsigned long long getCount(char *arg) {
+   char *end;
+   unsigned long long n = strtoull(arg, &end, 10);
+   if(*arg == '-' || *end != '\0' || n == 0)
+      printFileUsage();
+   return n;
+}
+
+/* Plays the results leading to a node back into the engine and returns the
+ * cell it fires at next, or NO_OPENING if no game gets there.
+ */
+static unsigned short findShot(Worker *w, unsigned int node) {
+   int results[MAX_DEPTH], n = 0, sinks = 0, hits;
+   Density *d = w->engine;
+   Shot shot;
+   for(; node > 0; node = (node - 1) / 3)
+      results[n++] = (node - 1) % 3 + 1;
+   densityStart(d, w->b->seed, w->b->size);
+   densityNewGame(d);
+   while(n-- > 0) {
+      if(sinks == NUMBER_OF_SHIPS || !densityChoose(d, &shot))
+         return NO_OPENING;
+      hits = d->hits;
+      densityRecord(d, shot, results[n]);
+      if(results[n] == SINK && d->hits >= hits)    // put down to no ship
+         return NO_OPENING;
+      sinks += results[n] == SINK;
+   }
+   if(sinks == NUMBER_OF_SHIPS || !densityChoose(d, &shot))
+      return NO_OPENING;
+   return shot.row * w->b->size + shot.col;
+}
+
+static void *work(void *arg) {
+   Worker *w = arg;
+   Builder *b = w->b;
+   unsigned int node, end;
+   while(1) {
+      pthread_mutex_lock(&b->lock);
+      node = b->next;
+      end = b->next = node + NODES_PER_TAKE < b->end ? node + NODES_PER_TAKE : b->end;
+      pthread_mutex_unlock(&b->lock);
+      if(node == end)
+         break;
+      for(; node < end; node++) {
+         if(node == 0 || b->cells[(node - 1) / 3] != NO_OPENING)
+            b->cells[node] = findShot(w, node);
+         else
+            b->cells[node] = NO_OPENING;
+      }
+   }
+   return NULL;
+}
+
+int main(int argc, char **argv) {
+   Builder b;
+   Worker *w;
+   pthread_t *threads;
+   unsigned int count, filled = 0, node;
+   char *end;
+   int c, i, level;
+   b.size = SIZE;
+   b.depth = DEPTH;
+   b.workers = sysconf(_SC_NPROCESSORS_ONLN);
+   b.seed = (unsigned long long)time(NULL) << 20 ^ getpid();
+   while((c = getopt(argc, argv, "b:d:t:S:")) != -1) {
+      if(c == 'd') {
+         b.depth = getCount(optarg);
+         if(b.depth > MAX_DEPTH)
+            printFileUsage();
+      }
+      else if(c == 't')
+         b.workers = getCount(optarg);
+      else if(c == 'b') {
+         b.size = getCount(optarg);
+         if(b.size < SIZE || b.size > MAX_SIZE)
+            printFileUsage();
+      }
+      else if(c == 'S') {
+         b.seed = strtoull(optarg, &end, 10);
+         if(*optarg == '-' || *end != '\0')
+            printFileUsage();
+      }
+      else
+         printFileUsage();
+   }
+   if(argc - optind != 1 || b.workers < 1)
+      printFileUsage();
+   count = openingNodes(b.depth);
+   b.cells = malloc(count * sizeof(b.cells[0]));
+   w = malloc(b.workers * sizeof(Worker));
+   threads = malloc(b.workers * sizeof(pthread_t));
+   if(b.cells == NULL || w == NULL || threads == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   pthread_mutex_init(&b.lock, NULL);
+   printf("Seed: %llu\n", b.seed);
+   for(i = 0; i < b.workers; i++) {
+      w[i].b = &b;
+      w[i].engine = densityCreate();
+   }
+   for(level = 0; level < b.depth; level++) {
+      b.next = openingNodes(level);
+      b.end = openingNodes(level + 1);
+      for(i = 0; i < b.workers; i++) {
+         if(pthread_create(&threads[i], NULL, work, &w[i])) {
+            fprintf(stderr, "thread failure in %s at line %d\n", __FILE__, __LINE__);
+            exit(EXIT_FAILURE);
+         }
+      }
+      for(i = 0; i < b.workers; i++)
+         pthread_join(threads[i], NULL);
+   }
+   for(node = 0; node < count; node++)
+      filled += b.cells[node] != NO_OPENING;
+   openingsWrite(argv[optind], b.size, b.depth, b.cells);
+   printf("%u of %u nodes of a %d shot opening on a %dx%d board\n", filled, count, b.depth,
+      b.size, b.size);
+   for(i = 0; i < b.workers; i++)
+      densityFree(w[i].engine);
+   exit(EXIT_SUCCESS);
+}
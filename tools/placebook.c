@@ -0,0 +1,318 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include "../match.h"
+#include "../placements.h"
+#include "../book.h"
+#include "../rng.h"
+
+/* Searches for fleets that a panel of attackers takes the most shots to sink
+ * and writes them to a placement book (book.h) for the smart player.
+ * Usage: placebook [-b size] [-n fleets] [-i steps] [-g games] [-t threads]
+ *                  [-S seed] book attacker1 attacker2 ...
+ *
+ * Every fleet of the book is the best one found by a chain of simulated
+ * annealing, and the chains are shared out between threads on all cores. A
+ * chain moves one ship at a time, either one cell over, turned about its first
+ * cell or anywhere at all, and keeps the move if the attackers need more shots
+ * to sink the fleet, or fewer by a margin that shrinks as the chain cools.
+ * The attackers are plugins, each with its own instance in every thread, and
+ * are started from the same seeds for every fleet of a chain so two fleets
+ * are compared on the same shots.
+ */
+
+#define FLEETS 32
+#define STEPS 1000
+#define GAMES_PER_FLEET 32
+
+/* How much worse than the current fleet, as a fraction of its shots, a move
+ * is taken by chance at the start of a chain and at its end.
+ */
+#define HOT 0.04
+#define COLD 0.001
+
+/* Struct holding the search and the fleets found so far.
+ */
+typedef struct{
+   int size, fleets, steps, games, workers, attackers;
+   char **args;
+   unsigned long long seed;
+   PlacementTable *table;
+   Fleet *book;
+   double *shots, *randomShots;  /* of each fleet found and of a random one */
+   int next;                     /* the next chain to run */
+   pthread_mutex_t lock;         /* protects next */
+} Search;
+
+/* A worker runs chains with its own instance of every attacker, and sinks
+ * the fleets on its own board as the host would.
+ */
+typedef struct{
+   Search *s;
+   Player *attackers;
+   BoardState board;
+} Worker;
+
+static void printFileUsage() {
+   fprintf(stderr, "Usage: placebook [-b size] [-n fleets] [-i steps] [-g games] [-t threads]\n");
+   fprintf(stderr, "                 [-S seed] book attacker1 attacker2 ...\n");
+   fprintf(stderr, "\t-b\tplace the fleets on a size x size board, %d to %d (default %d)\n",
+      SIZE, MAX_SIZE, SIZE);
+   fprintf(stderr, "\t-n\tnumber of fleets in the book (default %d)\n", FLEETS);
+   fprintf(stderr, "\t-i\tmoves tried to find each fleet (default %d)\n", STEPS);
+   fprintf(stderr, "\t-g\tgames each attacker plays against a fleet (default %d)\n",
+      GAMES_PER_FLEET);
+   fprintf(stderr, "\t-t\tnumber of threads (default one per core)\n");
+   fprintf(stderr, "\t-S\tseed of the search and the attackers (default from the clock)\n");
+   fprintf(stderr, "The attackers are plugins, given as file.so[:args].\n");
+   exit(EXIT_FAILURE);
+}
+
+static void toFleet(const PlacementTable *t, const int *placed, Fleet *fleet) {
+   int ship = 0, cell, down;
+   for(; ship < NUMBER_OF_SHIPS; ship++) {
+      cell = placementStart(t->size, fleetLength[ship], placed[ship] - t->shipPlacements[ship],
+         &down);
+      fleet->ships[ship].row = cell / t->size;
+      fleet->ships[ship].col = cell % t->size;
+      fleet->ships[ship].down = down;
+   }
+}
+
+/* Sets up the worker's board with a fleet. Returns 0 if two of its ships
+ * share a cell.
+ */
+static int placeShips(Worker *w, const int *placed) {
+   Fleet fleet;
+   toFleet(w->s->table, placed, &fleet);
+   return setupBoard(&w->board, &fleet, w->s->size) == 0;
+}
+
+/* The average number of shots the attackers take to sink a fleet, each
+ * playing games games from its own seed, with the shots resolved by the
+ * host's rules. An attacker that hasn't sunk it after four shots per cell is
+ * stopped there.
+ */
+static double shotsToSink(Worker *w, const int *placed, unsigned long long seed) {
+   const PlacementTable *t = w->s->table;
+   unsigned long long total = 0;
+   int a = 0, g, sunk, shots, result;
+   const PlayerPlugin *p;
+   MatchStart start;
+   Fleet fleet, ships;
+   toFleet(t, placed, &ships);
+   for(; a < w->s->attackers; a++) {
+      p = w->attackers[a].plugin;
+      start = seatStart(seed, a, t->size);
+      if(p->onMatchStart)
+         p->onMatchStart(w->attackers[a].ctx, &start);
+      for(g = 0; g < w->s->games; g++) {
+         p->newGame(w->attackers[a].ctx, &fleet);
+         setupBoard(&w->board, &ships, t->size);
+         for(shots = sunk = 0; sunk < NUMBER_OF_SHIPS && shots < 4 * t->cells; shots++) {
+            result = resolveShot(&w->board, p->chooseShot(w->attackers[a].ctx));
+            sunk += result == SINK;
+            p->onResult(w->attackers[a].ctx, result);
+         }
+         total += shots;
+      }
+   }
+   return (double)total / (w->s->attackers * w->s->games);
+}
+
+/* Moves a ship one cell over or turns it about its first cell, or half the
+ * time puts it anywhere. Returns the placement it moved to, or n if the move
+ * would take it off the board.
+ */
+static int moveShip(const PlacementTable *t, int ship, int n, unsigned long long *rng) {
+   int first = t->shipPlacements[ship], length = fleetLength[ship], size = t->size;
+   int cell, row, col, down, way;
+   if(rngBelow(rng, 2))
+      return first + rngBelow(rng, t->shipPlacements[ship + 1] - first);
+   cell = placementStart(size, length, n - first, &down);
+   row = cell / size;
+   col = cell % size;
+   way = rngBelow(rng, 5);
+   if(way == 4)
+      down = !down;
+   else {
+      row += way == 0 ? -1 : way == 1 ? 1 : 0;
+      col += way == 2 ? -1 : way == 3 ? 1 : 0;
+   }
+   if(row < 0 || col < 0 || row + (down ? length : 1) > size || col + (down ? 1 : length) > size)
+      return n;
+   return first + placementNumber(size, length, row * size + col, down);
+}
+
+/* Runs one chain from a random fleet and keeps the best fleet it finds. Both
+ * that and the fleet it started from are then played again from a seed the
+ * chain never saw, since the best fleet of a chain is partly the one its own
+ * seed happened to favour.
+ */
+static void runChain(Worker *w, int chain) {
+   Search *s = w->s;
+   const PlacementTable *t = s->table;
+   unsigned long long rng = s->seed + chain, seed, fresh;
+   int placed[NUMBER_OF_SHIPS], best[NUMBER_OF_SHIPS], first[NUMBER_OF_SHIPS];
+   int step = 0, ship, was;
+   double shots, tried, bestShots, temp;
+   rng = rngNext(&rng);
+   seed = rngNext(&rng);
+   fresh = rngNext(&rng);
+   do {
+      for(ship = 0; ship < NUMBER_OF_SHIPS; ship++)
+         placed[ship] = t->shipPlacements[ship] + rngBelow(&rng,
+            t->shipPlacements[ship + 1] - t->shipPlacements[ship]);
+   } while(!placeShips(w, placed));
+   memcpy(first, placed, sizeof(placed));
+   memcpy(best, placed, sizeof(placed));
+   shots = bestShots = shotsToSink(w, placed, seed);
+   for(; step < s->steps; step++) {
+      temp = HOT * pow(COLD / HOT, (double)step / s->steps);
+      ship = rngBelow(&rng, NUMBER_OF_SHIPS);
+      was = placed[ship];
+      if((placed[ship] = moveShip(t, ship, was, &rng)) == was)
+         continue;
+      if(!placeShips(w, placed)) {
+         placed[ship] = was;
+         continue;
+      }
+      tried = shotsToSink(w, placed, seed);
+      if(tried >= shots || (rngNext(&rng) >> 11) * 0x1p-53 < exp((tried - shots) / (temp * shots)))
+         shots = tried;
+      else
+         placed[ship] = was;
+      if(shots > bestShots) {
+         bestShots = shots;
+         memcpy(best, placed, sizeof(placed));
+      }
+   }
+   toFleet(t, best, &s->book[chain]);
+   s->shots[chain] = shotsToSink(w, best, fresh);
+   s->randomShots[chain] = shotsToSink(w, first, fresh);
+}
+
+static void *work(void *arg) {
+   Worker *w = arg;
+   Search *s = w->s;
+   int chain;
+   while(1) {
+      pthread_mutex_lock(&s->lock);
+      chain = s->next < s->fleets ? s->next++ : -1;
+      pthread_mutex_unlock(&s->lock);
+      if(chain == -1)
+         break;
+      runChain(w, chain);
+   }
+   return NULL;
+}
+
+/* Loads every attacker into the worker, which exits if one isn't a plugin.
+ */
+static void setupAttackers(Worker *w) {
+   MatchStart start = seatStart(w->s->seed, 0, w->s->size);
+   int a = 0;
+   if((w->attackers = malloc(w->s->attackers * sizeof(Player))) == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   for(; a < w->s->attackers; a++) {
+      setupPlayer(&w->attackers[a], w->s->args[a], 0, &start);
+      if(w->attackers[a].plugin == NULL) {
+         fprintf(stderr, "%s is not a plugin\n", w->s->args[a]);
+         endMatch(&w->attackers[a]);
+         exit(EXIT_FAILURE);
+      }
+      if(w->attackers[a].plugin->onMatchStart == NULL && w->s->size != SIZE) {
+         fprintf(stderr, "%s only plays on %dx%d boards\n", w->s->args[a], SIZE, SIZE);
+         exit(EXIT_FAILURE);
+      }
+   }
+}
+
+int main(int argc, char **argv) {
+   Search s;
+   Worker *w;
+   pthread_t *threads;
+   double shots = 0.0, randomShots = 0.0;
+   char *end, *path;
+   int c, i = 0;
+   s.size = SIZE;
+   s.fleets = FLEETS;
+   s.steps = STEPS;
+   s.games = GAMES_PER_FLEET;
+   s.workers = sysconf(_SC_NPROCESSORS_ONLN);
+   s.seed = (unsigned long long)time(NULL) << 20 ^ getpid();
+   while((c = getopt(argc, argv, "b:n:i:g:t:S:")) != -1) {
+      if(c == 'n')
+         s.fleets = getCount(optarg, printFileUsage);
+      else if(c == 'i')
+         s.steps = getCount(optarg, printFileUsage);
+      else if(c == 'g')
+         s.games = getCount(optarg, printFileUsage);
+      else if(c == 't')
+         s.workers = getCount(optarg, printFileUsage);
+      else if(c == 'b') {
+         s.size = getCount(optarg, printFileUsage);
+         if(s.size < SIZE || s.size > MAX_SIZE)
+            printFileUsage();
+      }
+      else if(c == 'S') {
+         s.seed = strtoull(optarg, &end, 10);
+         if(*optarg == '-' || *end != '\0')
+            printFileUsage();
+      }
+      else
+         printFileUsage();
+   }
+   if(argc - optind < 2 || s.workers < 1)
+      printFileUsage();
+   path = argv[optind];
+   s.args = argv + optind + 1;
+   s.attackers = argc - optind - 1;
+   if(s.workers > s.fleets)
+      s.workers = s.fleets;
+   s.table = placementsCreate(s.size);
+   s.book = malloc(s.fleets * sizeof(Fleet));
+   s.shots = malloc(s.fleets * sizeof(double));
+   s.randomShots = malloc(s.fleets * sizeof(double));
+   w = malloc(s.workers * sizeof(Worker));
+   threads = malloc(s.workers * sizeof(pthread_t));
+   if(s.book == NULL || s.shots == NULL || s.randomShots == NULL || w == NULL || threads == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   s.next = 0;
+   pthread_mutex_init(&s.lock, NULL);
+   printf("Seed: %llu\n", s.seed);
+   for(i = 0; i < s.workers; i++) {
+      w[i].s = &s;
+      initBoard(&w[i].board);
+      setupAttackers(&w[i]);
+   }
+   for(i = 0; i < s.workers; i++) {
+      if(pthread_create(&threads[i], NULL, work, &w[i])) {
+         fprintf(stderr, "thread failure in %s at line %d\n", __FILE__, __LINE__);
+         exit(EXIT_FAILURE);
+      }
+   }
+   for(i = 0; i < s.workers; i++)
+      pthread_join(threads[i], NULL);
+   for(i = 0; i < s.fleets; i++) {
+      shots += s.shots[i];
+      randomShots += s.randomShots[i];
+   }
+   bookWrite(path, s.size, s.book, s.fleets);
+   printf("%d fleets on a %dx%d board: %.2f shots to sink, against %.2f for random fleets\n",
+      s.fleets, s.size, s.size, shots / s.fleets, randomShots / s.fleets);
+   for(i = 0; i < s.workers; i++) {
+      for(c = 0; c < s.attackers; c++)
+         endMatch(&w[i].attackers[c]);
+      freeBoard(&w[i].board);
+   }
+   exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,360 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include "battleship.h"
+#include "match.h"
+#include "rng.h"
+
+#define MAX_PLAYERS 64
+#define ELO_START 1500.0
+#define ELO_K 16.0
+#define CHUNK 100
+#define MAX_TASKS (1 << 22)      /* 128 MB of tasks */
+
+/* Outcomes of a game as seen from the first player of a task.
+ */
+#define NO_WINNER 0
+#define FIRST_WON 1
+#define SECOND_WON 2
+#define BOTH_WON 3
+
+/* A task is a run of games between two players, played as one match with the
+ * first player shooting first.
+ */
+typedef struct{
+   int a, b;
+   unsigned long long games, seed;
+} Task;
+
+/* The tasks of one worker. The worker takes tasks from the bottom and idle
+ * workers steal them from the top.
+ */
+typedef struct{
+   pthread_mutex_t lock;
+   Task *tasks;
+   size_t top, bottom;
+} Deque;
+
+/* Struct holding the players, their ratings and the work left to do.
+ */
+typedef struct{
+   int players, workers;
+   char **args;
+   char names[MAX_PLAYERS][MAX_NAME];
+   double rating[MAX_PLAYERS], k;
+   unsigned long long seed;
+   long long moveNs, matchNs;    /* time a player has per answer and per match */
+   int simultaneous;             /* both players of a game shoot at once */
+   int size;                     /* of the board */
+   Score score[MAX_PLAYERS];
+   Stats *stats[MAX_PLAYERS];    /* NULL when the shots and boards aren't counted */
+   pthread_mutex_t lock;      /* protects rating, score and stats */
+   Deque *deques;
+} Tournament;
+
+/* A worker counts the stats of a task in its own pair, which are merged into
+ * the players' under the lock once the task is done.
+ */
+typedef struct{
+   Tournament *t;
+   int id;
+   Stats *stats[2];
+} Worker;
+
+static void printFileUsage() {
+   fprintf(stderr, "Usage: tournament [-g games] [-t threads] [-c chunk] [-k factor] ");
+   fprintf(stderr, "[-S seed] [-m ms] [-M ms] [-p]\n");
+   fprintf(stderr, "                  [-b size] [-H file] player1 player2 ...\n");
+   fprintf(stderr, "\t-g\tnumber of games for every pair of players (default %d)\n", GAMES);
+   fprintf(stderr, "\t-t\tnumber of threads playing matches (default one per core)\n");
+   fprintf(stderr, "\t-c\tgames played in a row by the same players (default %d)\n", CHUNK);
+   fprintf(stderr, "\t-k\tElo K-factor (default %g)\n", ELO_K);
+   fprintf(stderr, "\t-S\tseed the players' seeds come from (default from the clock)\n");
+   fprintf(stderr, "\t-m\tmilliseconds a player has for each answer\n");
+   fprintf(stderr, "\t-M\tmilliseconds a player has for all its answers in a match\n");
+   fprintf(stderr, "\t-p\task both players for their shots at once\n");
+   fprintf(stderr, "\t-b\tplay on a size x size board, %d to %d (default %d)\n",
+      SIZE, MAX_SIZE, SIZE);
+   fprintf(stderr, "\t-H\twrite the players' shot and ship heatmaps and how many shots\n");
+   fprintf(stderr, "\t\ttheir first hit, first sink and win took to file\n");
+   fprintf(stderr, "A player ending in .so[:args] is loaded as a plugin.\n");
+   exit(EXIT_FAILURE);
+}
+
+/* Split every pairing into tasks of at most chunk games and deal them out to
+ * the workers. The players swap seats from one task to the next so neither
+ * always shoots first. Every task gets its own seed so its games don't depend
+ * on which worker plays them. More than MAX_TASKS tasks is refused.
+ */
+static void setupTasks(Tournament *t, unsigned long long games,
+   unsigned long long chunk) {
+   unsigned long long left, n = games / chunk + (games % chunk != 0), seed = t->seed;
+   size_t pairs = (size_t)t->players * (t->players - 1) / 2, count, per;
+   int i = 0, j, w = 0;
+   Task task;
+   if(n > MAX_TASKS / pairs) {
+      fprintf(stderr, "%llu games of %llu make too many tasks, a larger -c makes fewer\n",
+         games, chunk);
+      exit(EXIT_FAILURE);
+   }
+   count = pairs * n;
+   per = (count + t->workers - 1) / t->workers;
+   if((t->deques = malloc(t->workers * sizeof(Deque))) == NULL) {
+      perror(NULL);
+      exit(EXIT_FAILURE);
+   }
+   for(; i < t->workers; i++) {
+      pthread_mutex_init(&t->deques[i].lock, NULL);
+      t->deques[i].tasks = malloc(per * sizeof(Task));
+      t->deques[i].top = t->deques[i].bottom = 0;
+      if(t->deques[i].tasks == NULL) {
+         perror(NULL);
+         exit(EXIT_FAILURE);
+      }
+   }
+   for(i = 0; i < t->players; i++) {
+      for(j = i + 1; j < t->players; j++) {
+         for(left = games; left > 0; left -= task.games) {
+            task.games = left < chunk ? left : chunk;
+            task.a = (left / chunk) % 2 ? i : j;
+            task.b = task.a == i ? j : i;
+            task.seed = rngNext(&seed);
+            t->deques[w].tasks[t->deques[w].bottom++] = task;
+            w = (w + 1) % t->workers;
+         }
+      }
+   }
+}
+
+/* Take a task from the worker's own deque, or steal one from another worker
+ * starting at a random one. Returns 0 once every deque is empty.
+ */
+static int takeTask(Tournament *t, int id, unsigned *seed, Task *task) {
+   Deque *d = &t->deques[id];
+   int i = 0, victim;
+   pthread_mutex_lock(&d->lock);
+   if(d->bottom > d->top) {
+      *task = d->tasks[--d->bottom];
+      pthread_mutex_unlock(&d->lock);
+      return 1;
+   }
+   pthread_mutex_unlock(&d->lock);
+   victim = rand_r(seed) % t->workers;
+   for(; i < t->workers; i++, victim = (victim + 1) % t->workers) {
+      d = &t->deques[victim];
+      pthread_mutex_lock(&d->lock);
+      if(d->bottom > d->top) {
+         *task = d->tasks[d->top++];
+         pthread_mutex_unlock(&d->lock);
+         return 1;
+      }
+      pthread_mutex_unlock(&d->lock);
+   }
+   return 0;
+}
+
+/* Move both ratings toward the result of one game, where result is 1 for a
+ * win of a, 0 for a loss and 0.5 otherwise.
+ */
+static void updateElo(Tournament *t, int a, int b, double result) {
+   double expected = 1.0 / (1.0 + pow(10.0, (t->rating[b] - t->rating[a]) / 400.0));
+   t->rating[a] += t->k * (result - expected);
+   t->rating[b] -= t->k * (result - expected);
+}
+
+/* Play the games of a task, then fold them into the ratings in the order they
+ * were played.
+ */
+static void runTask(Tournament *t, Task *task, unsigned char *outcome, Stats **stats) {
+   Player pA, pB;
+   Score sA = setupScore(), sB = setupScore();
+   unsigned long long i = 0;
+   MatchStart startA = seatStart(task->seed, 0, t->size);
+   MatchStart startB = seatStart(task->seed, 1, t->size);
+   int wins[2];
+   nameOpponent(&startA, t->args[task->b]);
+   nameOpponent(&startB, t->args[task->a]);
+   setupPlayer(&pA, t->args[task->a], 0, &startA);
+   setupPlayer(&pB, t->args[task->b], 0, &startB);
+   setupDeadlines(&pA, t->moveNs, t->matchNs);
+   setupDeadlines(&pB, t->moveNs, t->matchNs);
+   if(stats[0]) {
+      statsClear(stats[0]);
+      statsClear(stats[1]);
+      pA.stats = stats[0];
+      pB.stats = stats[1];
+   }
+   for(; i < task->games; i++) {
+      playGame(&pA, &pB, &sA, &sB, &wins, NULL, t->simultaneous);
+      outcome[i] = wins[0] * FIRST_WON + wins[1] * SECOND_WON;
+      endGame(&sA);
+      endGame(&sB);
+   }
+   endMatch(&pA);
+   endMatch(&pB);
+   pthread_mutex_lock(&t->lock);
+   for(i = 0; i < task->games; i++) {
+      if(outcome[i] == FIRST_WON)
+         updateElo(t, task->a, task->b, 1.0);
+      else if(outcome[i] == SECOND_WON)
+         updateElo(t, task->a, task->b, 0.0);
+      else
+         updateElo(t, task->a, task->b, 0.5);
+   }
+   addScore(&t->score[task->a], &sA);
+   addScore(&t->score[task->b], &sB);
+   if(stats[0]) {
+      statsMerge(t->stats[task->a], stats[0]);
+      statsMerge(t->stats[task->b], stats[1]);
+   }
+   pthread_mutex_unlock(&t->lock);
+}
+
+static void *work(void *arg) {
+   Worker *w = arg;
+   unsigned seed = w->id + 1;
+   unsigned char *outcome = malloc(CHUNK);
+   unsigned long long room = CHUNK;
+   Task task;
+   while(takeTask(w->t, w->id, &seed, &task)) {
+      if(task.games > room) {
+         room = task.games;
+         outcome = realloc(outcome, room);
+      }
+      if(outcome == NULL) {
+         perror(NULL);
+         exit(EXIT_FAILURE);
+      }
+      runTask(w->t, &task, outcome, w->stats);
+   }
+   free(outcome);
+   return NULL;
+}
+
+/* Prints the players from the highest rating to the lowest.
+ */
+static void printStandings(Tournament *t) {
+   int order[MAX_PLAYERS], i = 0, j, tmp;
+   for(; i < t->players; i++)
+      order[i] = i;
+   for(i = 1; i < t->players; i++) {
+      for(j = i; j > 0 && t->rating[order[j]] > t->rating[order[j-1]]; j--) {
+         tmp = order[j];
+         order[j] = order[j-1];
+         order[j-1] = tmp;
+      }
+   }
+   printf("\nTournament Results:\n");
+   printf("%4s %16s %8s %10s %10s %10s %10s\n", "", "player", "rating", "wins",
+      "draws", "losses", "forfeits");
+   for(i = 0; i < t->players; i++) {
+      j = order[i];
+      printf("%4d %16s %8.1f %10llu %10llu %10llu %10llu\n", i + 1, t->names[j],
+         t->rating[j], t->score[j].wins, t->score[j].draws, t->score[j].losses,
+         t->score[j].forfeits);
+   }
+}
+
+/* Writes the stats of every player as JSON lines, one per player.
+ */
+static void writeStats(Tournament *t, char *path) {
+   FILE *out = fopen(path, "w");
+   int i = 0;
+   if(out == NULL) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+   for(; i < t->players; i++) {
+      fprintf(out, "{\"player\":\"%s\",\"stats\":", t->names[i]);
+      statsWriteJson(out, t->stats[i]);
+      fprintf(out, "}\n");
+   }
+   if(fclose(out)) {
+      perror(path);
+      exit(EXIT_FAILURE);
+   }
+}
+
+/* Plays every pair of players against each other on all cores and prints the
+ * resulting Elo ratings.
+ */
+int main(int argc, char **argv) {
+   Tournament t;
+   Worker *w;
+   pthread_t *threads;
+   unsigned long long games = GAMES, chunk = CHUNK;
+   char *end, *stats = NULL;
+   int c, i = 0;
+   t.workers = sysconf(_SC_NPROCESSORS_ONLN);
+   t.k = ELO_K;
+   t.seed = (unsigned long long)time(NULL) << 20 ^ getpid();
+   t.moveNs = t.matchNs = 0;
+   t.simultaneous = 0;
+   t.size = SIZE;
+   while((c = getopt(argc, argv, "g:t:c:k:S:m:M:pb:H:")) != -1) {
+      if(c == 'g')
+         games = getCount(optarg, printFileUsage);
+      else if(c == 't')
+         t.workers = getCount(optarg, printFileUsage);
+      else if(c == 'c')
+         chunk = getCount(optarg, printFileUsage);
+      else if(c == 'k')
+         t.k = atof(optarg);
+      else if(c == 'm')
+         t.moveNs = getCount(optarg, printFileUsage) * 1000000LL;
+      else if(c == 'M')
+         t.matchNs = getCount(optarg, printFileUsage) * 1000000LL;
+      else if(c == 'p')
+         t.simultaneous = 1;
+      else if(c == 'H')
+         stats = optarg;
+      else if(c == 'b') {
+         t.size = getCount(optarg, printFileUsage);
+         if(t.size < SIZE || t.size > MAX_SIZE)
+            printFileUsage();
+      }
+      else if(c == 'S') {
+         t.seed = strtoull(optarg, &end, 10);
+         if(*optarg == '-' || *end != '\0')
+            printFileUsage();
+      }
+      else
+         printFileUsage();
+   }
+   t.players = argc - optind;
+   if(t.players < 2 || t.players > MAX_PLAYERS || t.workers < 1)
+      printFileUsage();
+   t.args = argv + optind;
+   for(; i < t.players; i++) {
+      getName(&t.names[i], t.args[i]);
+      t.rating[i] = ELO_START;
+      t.score[i] = setupScore();
+      t.stats[i] = stats ? statsCreate(t.size) : NULL;
+   }
+   signal(SIGPIPE, SIG_IGN);
+   pthread_mutex_init(&t.lock, NULL);
+   setupTasks(&t, games, chunk);
+   printf("Seed: %llu\n", t.seed);
+   w = malloc(t.workers * sizeof(Worker));
+   threads = malloc(t.workers * sizeof(pthread_t));
+   for(i = 0; i < t.workers; i++) {
+      w[i].t = &t;
+      w[i].id = i;
+      w[i].stats[0] = stats ? statsCreate(t.size) : NULL;
+      w[i].stats[1] = stats ? statsCreate(t.size) : NULL;
+      if(pthread_create(&threads[i], NULL, work, &w[i])) {
+         fprintf(stderr, "thread failure in %s at line %d\n", __FILE__, __LINE__);
+         exit(EXIT_FAILURE);
+      }
+   }
+   for(i = 0; i < t.workers; i++)
+      pthread_join(threads[i], NULL);
+   printStandings(&t);
+   if(stats)
+      writeStats(&t, stats);
+   exit(EXIT_SUCCESS);
+}